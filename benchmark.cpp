@@ -1,27 +1,44 @@
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
 #include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "Journal.h"
+#include "LatencyHistogram.h"
+#include "MatchingEngine.h"
 #include "OrderBook.h"
+#include "Trace.h"
 
 class PerformanceBenchmark {
 public:
+  // every generator is seeded from this unless --seed says otherwise, so two
+  // runs of the same binary send the same orders
+  static constexpr std::uint32_t DEFAULT_SEED = 42;
+
   struct BenchmarkResult {
-    double avgLatencyNs;
-    double maxLatencyNs;
-    double minLatencyNs;
+    LatencyHistogram latencies;
     double throughputOpsPerSec;
     size_t totalOperations;
   };
 
-  static BenchmarkResult BenchmarkAddOrders(int numOrders) {
-    Orderbook orderbook;
-    std::vector<double> latencies;
-    latencies.reserve(numOrders);
+  template <typename OrderbookType = Orderbook>
+  static BenchmarkResult BenchmarkAddOrders(int numOrders,
+                                            std::uint32_t seed) {
+    OrderbookType orderbook;
+    BenchmarkResult result{};
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    std::mt19937 gen(seed);
     std::uniform_int_distribution<> priceDist(90, 110);
     std::uniform_int_distribution<> quantityDist(1, 100);
     std::uniform_int_distribution<> sideDist(0, 1);
@@ -30,54 +47,70 @@ public:
 
     for (int i = 0; i < numOrders; ++i) {
       auto order =
-          std::make_shared<Order>(OrderType::GoodTillCancel, i + 1,
-                                  sideDist(gen) ? Side::Buy : Side::Sell,
-                                  priceDist(gen), quantityDist(gen));
+          Order(OrderType::GoodTillCancel, i + 1,
+                sideDist(gen) ? Side::Buy : Side::Sell,
+                priceDist(gen), quantityDist(gen));
 
       auto start = std::chrono::high_resolution_clock::now();
       orderbook.AddOrder(order);
       auto end = std::chrono::high_resolution_clock::now();
 
-      auto latency =
-          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
-              .count();
-      latencies.push_back(latency);
+      result.latencies.Record(ElapsedNs(start, end));
     }
 
     auto endTotal = std::chrono::high_resolution_clock::now();
-    auto totalTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                         endTotal - startTotal)
-                         .count();
+    Finish(result, numOrders, ElapsedNs(startTotal, endTotal));
+    return result;
+  }
 
-    // Calculate statistics
-    double sum = 0;
-    double maxLat = latencies[0];
-    double minLat = latencies[0];
+  // Same flow as BenchmarkAddOrders, handed to the book batchSize orders at a
+  // time through AddOrders with one reused trade buffer. Latency is per order.
+  static BenchmarkResult BenchmarkBatchAddOrders(int numOrders, int batchSize,
+                                                 std::uint32_t seed) {
+    Orderbook orderbook;
+    BenchmarkResult result{};
 
-    for (double lat : latencies) {
-      sum += lat;
-      if (lat > maxLat)
-        maxLat = lat;
-      if (lat < minLat)
-        minLat = lat;
-    }
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> priceDist(90, 110);
+    std::uniform_int_distribution<> quantityDist(1, 100);
+    std::uniform_int_distribution<> sideDist(0, 1);
 
-    double avgLatency = sum / latencies.size();
-    double throughput = (static_cast<double>(numOrders) * 1e9) / totalTime;
+    std::vector<Order> orders;
+    orders.reserve(numOrders);
+    for (int i = 0; i < numOrders; ++i)
+      orders.push_back(Order(OrderType::GoodTillCancel, i + 1,
+                             sideDist(gen) ? Side::Buy : Side::Sell,
+                             priceDist(gen), quantityDist(gen)));
+
+    Trades trades;
+    auto startTotal = std::chrono::high_resolution_clock::now();
 
-    return {avgLatency, maxLat, minLat, throughput,
-            static_cast<size_t>(numOrders)};
+    for (int i = 0; i < numOrders; i += batchSize) {
+      const auto count = std::min(batchSize, numOrders - i);
+      trades.clear();
+
+      auto start = std::chrono::high_resolution_clock::now();
+      orderbook.AddOrders(std::span{orders}.subspan(i, count), trades);
+      auto end = std::chrono::high_resolution_clock::now();
+
+      for (int j = 0; j < count; ++j)
+        result.latencies.Record(ElapsedNs(start, end) / count);
+    }
+
+    auto endTotal = std::chrono::high_resolution_clock::now();
+    Finish(result, numOrders, ElapsedNs(startTotal, endTotal));
+    return result;
   }
 
   // Benchmark different operation types
-  static BenchmarkResult BenchmarkMixedOperations(int numOperations) {
-    Orderbook orderbook;
-    std::vector<double> latencies;
-    latencies.reserve(numOperations);
+  template <typename OrderbookType = Orderbook>
+  static BenchmarkResult BenchmarkMixedOperations(int numOperations,
+                                                  std::uint32_t seed) {
+    OrderbookType orderbook;
+    BenchmarkResult result{};
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> priceDist(95, 105);
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> priceDist(90, 110);
     std::uniform_int_distribution<> quantityDist(1, 100);
     std::uniform_int_distribution<> sideDist(0, 1);
     std::uniform_int_distribution<> operationDist(
@@ -87,9 +120,9 @@ public:
     std::vector<OrderId> activeOrders;
     for (int i = 0; i < 50; ++i) {
       auto order =
-          std::make_shared<Order>(OrderType::GoodTillCancel, i + 1,
-                                  sideDist(gen) ? Side::Buy : Side::Sell,
-                                  priceDist(gen), quantityDist(gen));
+          Order(OrderType::GoodTillCancel, i + 1,
+                sideDist(gen) ? Side::Buy : Side::Sell,
+                priceDist(gen), quantityDist(gen));
       orderbook.AddOrder(order);
       activeOrders.push_back(i + 1);
     }
@@ -103,9 +136,9 @@ public:
       if (operation == 0 || activeOrders.empty()) {
         // Add order
         auto order =
-            std::make_shared<Order>(OrderType::GoodTillCancel, i + 1000,
-                                    sideDist(gen) ? Side::Buy : Side::Sell,
-                                    priceDist(gen), quantityDist(gen));
+            Order(OrderType::GoodTillCancel, i + 1000,
+                  sideDist(gen) ? Side::Buy : Side::Sell,
+                  priceDist(gen), quantityDist(gen));
         orderbook.AddOrder(order);
         activeOrders.push_back(i + 1000);
       } else if (operation == 1 && !activeOrders.empty()) {
@@ -127,91 +160,765 @@ public:
         activeOrders.erase(activeOrders.begin() + index);
 
         auto newOrder =
-            std::make_shared<Order>(OrderType::GoodTillCancel, i + 2000,
-                                    sideDist(gen) ? Side::Buy : Side::Sell,
-                                    priceDist(gen), quantityDist(gen));
+            Order(OrderType::GoodTillCancel, i + 2000,
+                  sideDist(gen) ? Side::Buy : Side::Sell,
+                  priceDist(gen), quantityDist(gen));
         orderbook.AddOrder(newOrder);
         activeOrders.push_back(i + 2000);
       }
 
       auto end = std::chrono::high_resolution_clock::now();
-      auto latency =
-          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
-              .count();
-      latencies.push_back(latency);
+      result.latencies.Record(ElapsedNs(start, end));
+    }
+
+    auto endTotal = std::chrono::high_resolution_clock::now();
+    Finish(result, numOperations, ElapsedNs(startTotal, endTotal));
+    return result;
+  }
+
+  // gateways_ == workers_, each gateway thread streams adds over every symbol
+  // and waits until all of them are acked, so this measures the engine's
+  // aggregate throughput as workers are added
+  static double BenchmarkMultiSymbol(int numOrders, int numSymbols,
+                                     std::size_t workers, std::uint32_t seed) {
+    std::vector<InstrumentId> instruments(numSymbols);
+    for (int symbol = 0; symbol < numSymbols; ++symbol)
+      instruments[symbol] = symbol;
+
+    MatchingEngineOptions options;
+    options.workers_ = workers;
+    options.gateways_ = workers;
+    options.ringCapacity_ = 1 << 12;
+    MatchingEngine engine{instruments, options};
+
+    std::vector<std::vector<Command>> streams(workers);
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> priceDist(90, 110);
+    std::uniform_int_distribution<> quantityDist(1, 100);
+    std::uniform_int_distribution<> sideDist(0, 1);
+    std::uniform_int_distribution<> symbolDist(0, numSymbols - 1);
+    for (std::size_t gateway = 0; gateway < workers; ++gateway)
+      for (int i = 0; i < numOrders; ++i)
+        streams[gateway].push_back(Command::Add(
+            Order(OrderType::GoodTillCancel, gateway * numOrders + i + 1,
+                  sideDist(gen) ? Side::Buy : Side::Sell, priceDist(gen),
+                  quantityDist(gen)),
+            symbolDist(gen)));
+
+    auto Drain = [&engine](std::size_t gateway, int &acked) {
+      Report report;
+      while (engine.Poll(gateway, report))
+        acked += report.type_ != ReportType::Trade;
+    };
+
+    auto startTotal = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> gateways;
+    for (std::size_t gateway = 0; gateway < workers; ++gateway)
+      gateways.emplace_back([&, gateway]() {
+        int acked = 0;
+        for (const auto &command : streams[gateway])
+          while (!engine.Submit(gateway, command))
+            Drain(gateway, acked);
+        while (acked < numOrders)
+          Drain(gateway, acked);
+      });
+    for (auto &gateway : gateways)
+      gateway.join();
+
+    auto endTotal = std::chrono::high_resolution_clock::now();
+    return static_cast<double>(numOrders) * workers * 1e9 /
+           ElapsedNs(startTotal, endTotal);
+  }
+
+  // the book's old order id index, used the way the book used it: a contains
+  // before every insert, a find then an erase to take an order out
+  struct MapIndex {
+    std::pmr::unsynchronized_pool_resource resource;
+    std::pmr::unordered_map<OrderId, Order *> orders{&resource};
+
+    explicit MapIndex(std::size_t) {}
+    bool Insert(OrderId orderId, Order *order) {
+      if (orders.contains(orderId))
+        return false;
+      orders.emplace(orderId, order);
+      return true;
+    }
+    Order *Find(OrderId orderId) {
+      const auto entry = orders.find(orderId);
+      return entry == orders.end() ? nullptr : entry->second;
+    }
+    Order *Erase(OrderId orderId) {
+      const auto entry = orders.find(orderId);
+      if (entry == orders.end())
+        return nullptr;
+      Order *order = entry->second;
+      orders.erase(entry);
+      return order;
+    }
+  };
+
+  struct TableIndex {
+    std::pmr::unsynchronized_pool_resource resource;
+    OrderTable orders;
+
+    explicit TableIndex(std::size_t capacity) : orders{&resource, capacity} {}
+    bool Insert(OrderId orderId, Order *order) {
+      return orders.Insert(orderId, order);
+    }
+    Order *Find(OrderId orderId) { return orders.Find(orderId); }
+    Order *Erase(OrderId orderId) { return orders.Erase(orderId); }
+  };
+
+  // a book's worth of resting ids churned through an index: every step adds
+  // the next id, looks up a resting one (a modify) and takes out another (a
+  // cancel or fill). Returns ns per index operation.
+  template <typename Index>
+  static double BenchmarkOrderIndex(std::span<const OrderId> ids,
+                                    std::size_t resting, std::uint32_t seed) {
+    Index index{resting};
+    Order order{OrderType::GoodTillCancel, 1, Side::Buy, 100, 1};
+    std::vector<OrderId> live(ids.begin(), ids.begin() + resting);
+    for (const auto orderId : live)
+      index.Insert(orderId, &order);
+
+    std::mt19937 gen(seed);
+    std::uintptr_t found{};
+    auto startTotal = std::chrono::high_resolution_clock::now();
+
+    for (auto next = resting; next < ids.size(); ++next) {
+      index.Insert(ids[next], &order);
+      found += reinterpret_cast<std::uintptr_t>(
+          index.Find(live[gen() % live.size()]));
+
+      auto &leaving = live[gen() % live.size()];
+      index.Erase(leaving);
+      leaving = ids[next];
+    }
+
+    auto endTotal = std::chrono::high_resolution_clock::now();
+    if (found == 0)
+      std::cout << ""; // keeps the lookups from being optimised out
+    return ElapsedNs(startTotal, endTotal) /
+           (3.0 * static_cast<double>(ids.size() - resting));
+  }
+
+  static void BenchmarkOrderIndexes(int numOperations, std::size_t resting,
+                                    std::uint32_t seed) {
+    const auto count = resting + static_cast<std::size_t>(numOperations);
+
+    // ids handed out in sequence by the venue for the session
+    std::vector<OrderId> monotonic(count);
+    for (std::size_t i = 0; i < count; ++i)
+      monotonic[i] = i + 1;
+
+    // client assigned ids: sparse over the whole 64 bit range
+    std::mt19937_64 gen(seed);
+    std::vector<OrderId> sparse(count);
+    for (auto &orderId : sparse)
+      orderId = gen();
+
+    for (const auto &[name, ids] :
+         {std::pair{"monotonic", &monotonic}, std::pair{"sparse", &sparse}}) {
+      std::cout << name << " ids: unordered_map "
+                << BenchmarkOrderIndex<MapIndex>(*ids, resting, seed)
+                << " ns/op, OrderTable "
+                << BenchmarkOrderIndex<TableIndex>(*ids, resting, seed)
+                << " ns/op" << std::endl;
+    }
+  }
+
+  // journals a mixed add/cancel flow once, then times mapping it back in and
+  // rebuilding a book from it, i.e. the recovery time per event
+  static double BenchmarkJournalReplay(int numCommands, std::uint32_t seed) {
+    const auto path =
+        (std::filesystem::temp_directory_path() / "orderbook_replay.bin")
+            .string();
+    std::filesystem::remove(path);
+
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> priceDist(90, 110);
+    std::uniform_int_distribution<> quantityDist(1, 100);
+    std::uniform_int_distribution<> sideDist(0, 1);
+    std::uniform_int_distribution<> actionDist(0, 3);
+    {
+      JournalWriter journal{path};
+      for (int i = 0; i < numCommands; ++i)
+        journal.Append(
+            actionDist(gen) == 0 && i > 0
+                ? Command::Cancel(gen() % i + 1)
+                : Command::Add(Order(OrderType::GoodTillCancel, i + 1,
+                                     sideDist(gen) ? Side::Buy : Side::Sell,
+                                     priceDist(gen), quantityDist(gen))));
     }
 
+    auto startTotal = std::chrono::high_resolution_clock::now();
+
+    JournalReader reader{path};
+    OrderbookOptions options;
+    options.orderCapacity_ = numCommands;
+    SingleWriterOrderbook orderbook{options};
+    Trades trades;
+    trades.reserve(numCommands);
+    reader.Replay(orderbook, trades);
+
     auto endTotal = std::chrono::high_resolution_clock::now();
-    auto totalTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                         endTotal - startTotal)
-                         .count();
 
-    // Calculate statistics
-    double sum = 0;
-    double maxLat = latencies[0];
-    double minLat = latencies[0];
+    std::filesystem::remove(path);
+    return static_cast<double>(numCommands) * 1e9 /
+           ElapsedNs(startTotal, endTotal);
+  }
+
+  // a book far bigger than the caches, every level's queue scattered over the
+  // pool because the orders arrive in random price order, swept by aggressive
+  // FAKs. Returns ns per fill, i.e. what a cache miss per order costs.
+  static double BenchmarkFills(int numResting, std::uint32_t seed) {
+    OrderbookOptions options;
+    options.threading_ = Threading::SingleWriter;
+    options.orderCapacity_ = numResting;
+    Orderbook orderbook{options};
+
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> priceDist(1'000, 1'999);
+    for (int i = 0; i < numResting; ++i)
+      orderbook.AddOrder(Order(OrderType::GoodTillCancel, i + 1, Side::Sell,
+                               priceDist(gen), 10));
+
+    std::size_t fills{};
+    auto Count = [&fills](const Execution &) { ++fills; };
+
+    auto startTotal = std::chrono::high_resolution_clock::now();
+
+    // each FAK takes the next hundred orders off the front of the book
+    for (OrderId orderId = numResting + 1; orderbook.Size() > 0; ++orderId)
+      orderbook.AddOrder(
+          Order(OrderType::FillAndKill, orderId, Side::Buy, 1'999, 1'000),
+          Count);
+
+    auto endTotal = std::chrono::high_resolution_clock::now();
+    return ElapsedNs(startTotal, endTotal) / static_cast<double>(fills);
+  }
+
+  // a book of numOrders resting orders: how long Snapshot() holds the book,
+  // and how long mapping the file and restoring a fresh book takes
+  static void BenchmarkSnapshot(int numOrders, std::uint32_t seed) {
+    const auto path =
+        (std::filesystem::temp_directory_path() / "orderbook_snapshot.bin")
+            .string();
+
+    OrderbookOptions options;
+    options.threading_ = Threading::SingleWriter;
+    options.orderCapacity_ = numOrders;
+
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> offsetDist(1, 500);
+    std::uniform_int_distribution<> quantityDist(1, 100);
+    Orderbook orderbook{options};
+    for (int i = 0; i < numOrders; ++i) {
+      const auto side = i % 2 ? Side::Buy : Side::Sell;
+      const auto offset = offsetDist(gen);
+      orderbook.AddOrder(Order(OrderType::GoodTillCancel, i + 1, side,
+                               side == Side::Buy ? 1000 - offset
+                                                 : 1000 + offset,
+                               quantityDist(gen)));
+    }
 
-    for (double lat : latencies) {
-      sum += lat;
-      if (lat > maxLat)
-        maxLat = lat;
-      if (lat < minLat)
-        minLat = lat;
+    using std::chrono::high_resolution_clock;
+    auto Millis = [](auto from, auto to) {
+      return std::chrono::duration<double, std::milli>(to - from).count();
+    };
+
+    auto start = high_resolution_clock::now();
+    const auto snapshot = orderbook.Snapshot();
+    auto copied = high_resolution_clock::now();
+    WriteSnapshot(path, snapshot);
+    auto written = high_resolution_clock::now();
+
+    Orderbook restored{options};
+    {
+      SnapshotReader reader{path};
+      restored.Restore(reader.Orders());
     }
+    auto loaded = high_resolution_clock::now();
+
+    std::cout << "Snapshot pause (copy): " << Millis(start, copied) << " ms"
+              << std::endl;
+    std::cout << "Snapshot write: " << Millis(copied, written) << " ms"
+              << std::endl;
+    std::cout << "Snapshot load: " << Millis(written, loaded) << " ms"
+              << std::endl;
 
-    double avgLatency = sum / latencies.size();
-    double throughput = (static_cast<double>(numOperations) * 1e9) / totalTime;
+    std::filesystem::remove(path);
+  }
 
-    return {avgLatency, maxLat, minLat, throughput,
-            static_cast<size_t>(numOperations)};
+  // a closing auction of numOrders orders on both sides of a 1000 wide band,
+  // so most of the levels cross: the indicative price, which is one walk of
+  // the crossed levels, and the uncross that executes them
+  static void BenchmarkAuction(int numOrders, std::uint32_t seed) {
+    OrderbookOptions options;
+    options.threading_ = Threading::SingleWriter;
+    options.orderCapacity_ = numOrders;
+    Orderbook orderbook{options};
+    orderbook.StartAuction();
+
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> priceDist(500, 1'500);
+    std::uniform_int_distribution<> quantityDist(1, 100);
+    for (int i = 0; i < numOrders; ++i)
+      orderbook.AddOrder(Order(OrderType::GoodTillCancel, i + 1,
+                               i % 2 ? Side::Buy : Side::Sell, priceDist(gen),
+                               quantityDist(gen)));
+
+    using std::chrono::high_resolution_clock;
+    auto Micros = [](auto from, auto to) {
+      return std::chrono::duration<double, std::micro>(to - from).count();
+    };
+
+    std::size_t fills{};
+    auto Count = [&fills](const Execution &) { ++fills; };
+
+    auto start = high_resolution_clock::now();
+    const auto indication = orderbook.PublishIndicativeUncross();
+    auto indicated = high_resolution_clock::now();
+    orderbook.Uncross(Count);
+    auto uncrossed = high_resolution_clock::now();
+
+    std::cout << "Indicative price (volume " << indication.volume_
+              << "): " << Micros(start, indicated) << " us" << std::endl;
+    std::cout << "Uncross (" << fills << " fills): "
+              << Micros(indicated, uncrossed) / 1'000 << " ms" << std::endl;
   }
 
-  static void PrintPercentiles(const std::vector<double> &latencies) {
-    auto sortedLatencies = latencies;
-    std::sort(sortedLatencies.begin(), sortedLatencies.end());
+  // Scenarios: a generator builds the whole command stream up front from the
+  // seed, an untimed warmup part that shapes the book and a measured part
+  // timed one command at a time. Books run SingleWriter so the numbers are
+  // the matching path itself, not the mutex.
+  struct Workload {
+    std::size_t symbols = 1;
+    std::vector<Command> warmup;
+    std::vector<Command> measured;
+  };
+
+  struct Scenario {
+    std::string_view name;
+    std::string_view description;
+    Workload (*generate)(std::mt19937 &gen, int operations);
+  };
+
+  static std::span<const Scenario> Scenarios() {
+    static const Scenario scenarios[] = {
+        {"deep-book", "200k resting orders over 1000 levels a side",
+         &DeepBook},
+        {"wide-spread", "sparse levels over 20000 ticks, add/cancel",
+         &WideSpread},
+        {"cancel-heavy", "80% cancels of resting orders", &CancelHeavy},
+        {"fok-heavy", "70% FillOrKill probing several levels", &FillOrKillHeavy},
+        {"market-sweep", "market orders sweeping levels between refills",
+         &MarketSweep},
+        {"many-symbol", "1024 books, add/cancel on a random symbol",
+         &ManySymbol},
+    };
+    return scenarios;
+  }
+
+  static BenchmarkResult RunScenario(const Scenario &scenario,
+                                     std::uint32_t seed, int operations) {
+    std::mt19937 gen(seed);
+    const auto workload = scenario.generate(gen, operations);
+
+    OrderbookOptions options;
+    options.threading_ = Threading::SingleWriter;
+    std::vector<std::unique_ptr<Orderbook>> books;
+    for (std::size_t symbol = 0; symbol < workload.symbols; ++symbol)
+      books.push_back(std::make_unique<Orderbook>(options));
+
+    Trades trades;
+    auto Apply = [&books, &trades](const Command &command) {
+      trades.clear();
+      books[command.instrumentId_]->ProcessCommands(std::span{&command, 1},
+                                                    trades);
+    };
+
+    for (const auto &command : workload.warmup)
+      Apply(command);
+
+    BenchmarkResult result{};
+    auto startTotal = std::chrono::high_resolution_clock::now();
+
+    for (const auto &command : workload.measured) {
+      auto start = std::chrono::high_resolution_clock::now();
+      Apply(command);
+      auto end = std::chrono::high_resolution_clock::now();
+
+      result.latencies.Record(ElapsedNs(start, end));
+    }
+
+    auto endTotal = std::chrono::high_resolution_clock::now();
+    Finish(result, workload.measured.size(), ElapsedNs(startTotal, endTotal));
+    return result;
+  }
 
-    size_t size = sortedLatencies.size();
-    std::cout << "50th percentile: " << sortedLatencies[size * 50 / 100]
-              << " ns" << std::endl;
-    std::cout << "90th percentile: " << sortedLatencies[size * 90 / 100]
-              << " ns" << std::endl;
-    std::cout << "95th percentile: " << sortedLatencies[size * 95 / 100]
-              << " ns" << std::endl;
-    std::cout << "99th percentile: " << sortedLatencies[size * 99 / 100]
-              << " ns" << std::endl;
-    std::cout << "99.9th percentile: " << sortedLatencies[size * 999 / 1000]
-              << " ns" << std::endl;
+  static void PrintPercentiles(const LatencyHistogram &latencies) {
+    for (const double percentile : {50.0, 90.0, 99.0, 99.9, 99.99})
+      std::cout << percentile
+                << "th percentile: " << latencies.Percentile(percentile)
+                << " ns" << std::endl;
   }
 
   static void PrintResults(const BenchmarkResult &result,
                            const std::string &testName) {
     std::cout << "\n=== " << testName << " ===" << std::endl;
     std::cout << "Total Operations: " << result.totalOperations << std::endl;
-    std::cout << "Average Latency: " << result.avgLatencyNs << " ns"
+    std::cout << "Average Latency: " << result.latencies.Mean() << " ns"
+              << std::endl;
+    std::cout << "Min Latency: " << result.latencies.Min() << " ns"
+              << std::endl;
+    std::cout << "Max Latency: " << result.latencies.Max() << " ns"
               << std::endl;
-    std::cout << "Min Latency: " << result.minLatencyNs << " ns" << std::endl;
-    std::cout << "Max Latency: " << result.maxLatencyNs << " ns" << std::endl;
     std::cout << "Throughput: " << result.throughputOpsPerSec << " ops/sec"
               << std::endl;
+    PrintPercentiles(result.latencies);
+  }
+
+  // flat JSON, one object per run, for regression gates to diff against
+  static void WriteJson(
+      const std::string &path, std::uint32_t seed,
+      const std::vector<std::pair<std::string, BenchmarkResult>> &results) {
+    std::ofstream file{path};
+    file << "{\n  \"seed\": " << seed << ",\n  \"results\": [";
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      const auto &[name, result] = results[i];
+      const auto &latencies = result.latencies;
+      file << (i ? "," : "") << "\n    {\"name\": \"" << name << "\""
+           << ", \"operations\": " << result.totalOperations
+           << ", \"throughput_ops_per_sec\": " << result.throughputOpsPerSec
+           << ", \"mean_ns\": " << latencies.Mean()
+           << ", \"min_ns\": " << latencies.Min()
+           << ", \"p50_ns\": " << latencies.Percentile(50)
+           << ", \"p90_ns\": " << latencies.Percentile(90)
+           << ", \"p99_ns\": " << latencies.Percentile(99)
+           << ", \"p99_9_ns\": " << latencies.Percentile(99.9)
+           << ", \"p99_99_ns\": " << latencies.Percentile(99.99)
+           << ", \"max_ns\": " << latencies.Max() << "}";
+    }
+    file << "\n  ]\n}\n";
+  }
+
+private:
+  template <typename TimePoint>
+  static std::uint64_t ElapsedNs(TimePoint start, TimePoint end) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+        .count();
+  }
+
+  static void Finish(BenchmarkResult &result, std::size_t operations,
+                     std::uint64_t totalTimeNs) {
+    result.totalOperations = operations;
+    result.throughputOpsPerSec =
+        static_cast<double>(operations) * 1e9 / totalTimeNs;
+  }
+
+  // hands out order ids and remembers what may still rest, so cancels mostly
+  // name live orders
+  class Flow {
+  public:
+    explicit Flow(std::mt19937 &gen) : gen_{gen} {}
+
+    Command Add(OrderType type, Side side, Price price, Quantity quantity,
+                InstrumentId instrumentId = {}) {
+      const auto orderId = ++nextOrderId_;
+      resting_.push_back({orderId, instrumentId});
+      return Command::Add(Order(type, orderId, side, price, quantity),
+                          instrumentId);
+    }
+
+    Command Market(Side side, Quantity quantity) {
+      return Command::Add(Order(++nextOrderId_, side, quantity));
+    }
+
+    bool HasResting() const { return !resting_.empty(); }
+
+    Command CancelAny() {
+      const auto index = gen_() % resting_.size();
+      const auto [orderId, instrumentId] = resting_[index];
+      resting_[index] = resting_.back();
+      resting_.pop_back();
+      return Command::Cancel(orderId, instrumentId);
+    }
+
+    int Uniform(int low, int high) {
+      return std::uniform_int_distribution<>{low, high}(gen_);
+    }
+    Side AnySide() { return Uniform(0, 1) ? Side::Buy : Side::Sell; }
+
+  private:
+    std::mt19937 &gen_;
+    OrderId nextOrderId_{};
+    std::vector<std::pair<OrderId, InstrumentId>> resting_;
+  };
+
+  // resting order offset ticks away from mid on its own side
+  static Command Passive(Flow &flow, Price mid, int offset,
+                         InstrumentId instrumentId = {}) {
+    const auto side = flow.AnySide();
+    return flow.Add(OrderType::GoodTillCancel, side,
+                    side == Side::Buy ? mid - offset : mid + offset,
+                    flow.Uniform(1, 100), instrumentId);
+  }
+
+  static Workload DeepBook(std::mt19937 &gen, int operations) {
+    Flow flow{gen};
+    Workload workload;
+    for (int i = 0; i < 200'000; ++i)
+      workload.warmup.push_back(Passive(flow, 10'000, flow.Uniform(1, 1000)));
+
+    for (int i = 0; i < operations; ++i) {
+      const auto action = flow.Uniform(0, 99);
+      if (action < 45 || !flow.HasResting())
+        workload.measured.push_back(
+            Passive(flow, 10'000, flow.Uniform(1, 1000)));
+      else if (action < 90)
+        workload.measured.push_back(flow.CancelAny());
+      else {
+        // crosses the touch by a few ticks
+        const auto side = flow.AnySide();
+        workload.measured.push_back(flow.Add(
+            OrderType::GoodTillCancel, side,
+            side == Side::Buy ? 10'005 : 9'995, flow.Uniform(1, 300)));
+      }
+    }
+    return workload;
+  }
+
+  static Workload WideSpread(std::mt19937 &gen, int operations) {
+    Flow flow{gen};
+    Workload workload;
+    for (int i = 0; i < 5'000; ++i)
+      workload.warmup.push_back(Passive(flow, 10'000, flow.Uniform(1, 10'000)));
+
+    for (int i = 0; i < operations; ++i)
+      workload.measured.push_back(
+          flow.Uniform(0, 1) || !flow.HasResting()
+              ? Passive(flow, 10'000, flow.Uniform(1, 10'000))
+              : flow.CancelAny());
+    return workload;
+  }
+
+  static Workload CancelHeavy(std::mt19937 &gen, int operations) {
+    Flow flow{gen};
+    Workload workload;
+    for (int i = 0; i < 50'000; ++i)
+      workload.warmup.push_back(Passive(flow, 100, flow.Uniform(1, 10)));
+
+    for (int i = 0; i < operations; ++i)
+      workload.measured.push_back(
+          flow.Uniform(0, 4) == 0 || !flow.HasResting()
+              ? Passive(flow, 100, flow.Uniform(1, 10))
+              : flow.CancelAny());
+    return workload;
+  }
+
+  static Workload FillOrKillHeavy(std::mt19937 &gen, int operations) {
+    Flow flow{gen};
+    Workload workload;
+    for (int i = 0; i < 20'000; ++i)
+      workload.warmup.push_back(Passive(flow, 1'000, flow.Uniform(1, 100)));
+
+    for (int i = 0; i < operations; ++i) {
+      if (flow.Uniform(0, 9) < 3) {
+        workload.measured.push_back(Passive(flow, 1'000, flow.Uniform(1, 100)));
+        continue;
+      }
+
+      // sizes and limits chosen so a good share of them gets killed
+      const auto side = flow.AnySide();
+      const auto reach = flow.Uniform(1, 20);
+      workload.measured.push_back(flow.Add(
+          OrderType::FillOrKill, side,
+          side == Side::Buy ? 1'000 + reach : 1'000 - reach,
+          flow.Uniform(1, 2'000)));
+    }
+    return workload;
+  }
+
+  static Workload MarketSweep(std::mt19937 &gen, int operations) {
+    Flow flow{gen};
+    Workload workload;
+    for (int i = 0; i < 20'000; ++i)
+      workload.warmup.push_back(Passive(flow, 1'000, flow.Uniform(1, 50)));
+
+    for (int i = 0; i < operations; ++i)
+      workload.measured.push_back(
+          flow.Uniform(0, 9) == 0
+              ? flow.Market(flow.AnySide(), flow.Uniform(500, 5'000))
+              : Passive(flow, 1'000, flow.Uniform(1, 20)));
+    return workload;
+  }
+
+  static Workload ManySymbol(std::mt19937 &gen, int operations) {
+    Flow flow{gen};
+    Workload workload;
+    workload.symbols = 1024;
+
+    auto Symbol = [&flow, &workload]() {
+      return static_cast<InstrumentId>(
+          flow.Uniform(0, static_cast<int>(workload.symbols) - 1));
+    };
+
+    for (std::size_t i = 0; i < 100 * workload.symbols; ++i)
+      workload.warmup.push_back(
+          Passive(flow, 1'000, flow.Uniform(1, 20), Symbol()));
+
+    for (int i = 0; i < operations; ++i)
+      workload.measured.push_back(
+          flow.Uniform(0, 1) || !flow.HasResting()
+              ? Passive(flow, 1'000, flow.Uniform(0, 20), Symbol())
+              : flow.CancelAny());
+    return workload;
   }
 };
 
-int main() {
+namespace {
+void PrintUsage(const char *program) {
+  std::cout << "usage: " << program
+            << " [--seed N] [--ops N] [--scenario NAME]... [--json PATH]"
+               " [--trace PATH]\n"
+               "  no --scenario runs every section and every scenario\n"
+               "  --trace needs a build with -DORDERBOOK_TRACE=ON\n"
+               "scenarios:\n";
+  for (const auto &scenario : PerformanceBenchmark::Scenarios())
+    std::cout << "  " << scenario.name << ": " << scenario.description
+              << "\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  std::uint32_t seed = PerformanceBenchmark::DEFAULT_SEED;
+  int operations = 100'000;
+  std::vector<std::string_view> selected;
+  std::string jsonPath;
+  std::string tracePath;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view argument = argv[i];
+    if (argument == "--seed" && i + 1 < argc)
+      seed = static_cast<std::uint32_t>(std::stoul(argv[++i]));
+    else if (argument == "--ops" && i + 1 < argc)
+      operations = std::stoi(argv[++i]);
+    else if (argument == "--scenario" && i + 1 < argc)
+      selected.push_back(argv[++i]);
+    else if (argument == "--json" && i + 1 < argc)
+      jsonPath = argv[++i];
+    else if (argument == "--trace" && i + 1 < argc)
+      tracePath = argv[++i];
+    else {
+      PrintUsage(argv[0]);
+      return argument == "--help" ? 0 : 1;
+    }
+  }
+
   std::cout << "OrderBook Performance Benchmark" << std::endl;
   std::cout << "==============================" << std::endl;
+  std::cout << "Seed: " << seed << std::endl;
+
+  std::vector<std::pair<std::string, PerformanceBenchmark::BenchmarkResult>>
+      results;
+  auto Report = [&results](std::string name,
+                           PerformanceBenchmark::BenchmarkResult result) {
+    PerformanceBenchmark::PrintResults(result, name);
+    results.emplace_back(std::move(name), std::move(result));
+  };
 
-  // Benchmark different order counts
-  std::vector<int> orderCounts = {1000, 5000, 10000};
+  if (selected.empty()) {
+    // Benchmark different order counts
+    std::vector<int> orderCounts = {1000, 5000, 10000};
+
+    for (int count : orderCounts)
+      Report("Add " + std::to_string(count) + " Orders",
+             PerformanceBenchmark::BenchmarkAddOrders(count, seed));
+
+    std::cout << "\n\n=== Mixed Operations Benchmark ===" << std::endl;
+    Report("Mixed Operations (5000)",
+           PerformanceBenchmark::BenchmarkMixedOperations(5000, seed));
+
+    std::cout << "\n\n=== Batch Entry ===" << std::endl;
+    for (int batchSize : {16, 256})
+      Report("Batch Add 10000 Orders (batch " + std::to_string(batchSize) +
+                 ")",
+             PerformanceBenchmark::BenchmarkBatchAddOrders(10000, batchSize,
+                                                           seed));
+
+    std::cout << "\n\n=== Ladder Price Levels ===" << std::endl;
+    for (int count : orderCounts)
+      Report("Ladder Add " + std::to_string(count) + " Orders",
+             PerformanceBenchmark::BenchmarkAddOrders<LadderOrderbook>(count,
+                                                                      seed));
+
+    Report("Ladder Mixed Operations (5000)",
+           PerformanceBenchmark::BenchmarkMixedOperations<LadderOrderbook>(
+               5000, seed));
+
+    std::cout << "\n\n=== Single Writer Policies ===" << std::endl;
+    for (int count : orderCounts)
+      Report("Single Writer Add " + std::to_string(count) + " Orders",
+             PerformanceBenchmark::BenchmarkAddOrders<SingleWriterOrderbook>(
+                 count, seed));
+
+    Report("Single Writer Mixed Operations (5000)",
+           PerformanceBenchmark::BenchmarkMixedOperations<
+               SingleWriterOrderbook>(5000, seed));
+
+    std::cout << "\n\n=== Order Id Index (100000 resting) ===" << std::endl;
+    PerformanceBenchmark::BenchmarkOrderIndexes(1'000'000, 100'000, seed);
+
+    std::cout << "\n\n=== Journal Replay ===" << std::endl;
+    std::cout << "Replay 1000000 commands: "
+              << PerformanceBenchmark::BenchmarkJournalReplay(1'000'000, seed)
+              << " events/sec" << std::endl;
+
+    std::cout << "\n\n=== Fills (2000000 resting orders) ===" << std::endl;
+    std::cout << "Sweep: " << PerformanceBenchmark::BenchmarkFills(2'000'000, seed)
+              << " ns/fill" << std::endl;
+
+    std::cout << "\n\n=== Closing Auction (500000 orders) ===" << std::endl;
+    PerformanceBenchmark::BenchmarkAuction(500'000, seed);
+
+    std::cout << "\n\n=== Snapshot (1000000 resting orders) ===" << std::endl;
+    PerformanceBenchmark::BenchmarkSnapshot(1'000'000, seed);
+
+    std::cout << "\n\n=== Multi-Symbol Engine ===" << std::endl;
+    const auto maxWorkers =
+        std::max<std::size_t>(1, std::thread::hardware_concurrency() / 2);
+    for (std::size_t workers = 1; workers <= maxWorkers; workers *= 2) {
+      const auto throughput = PerformanceBenchmark::BenchmarkMultiSymbol(
+          100000, 256, workers, seed);
+      std::cout << workers << " worker(s), 256 symbols: " << throughput
+                << " ops/sec" << std::endl;
+    }
+  }
+
+  std::cout << "\n\n=== Scenarios (" << operations << " operations) ==="
+            << std::endl;
+  for (const auto &scenario : PerformanceBenchmark::Scenarios()) {
+    if (!selected.empty() &&
+        std::find(selected.begin(), selected.end(), scenario.name) ==
+            selected.end())
+      continue;
 
-  for (int count : orderCounts) {
-    auto result = PerformanceBenchmark::BenchmarkAddOrders(count);
-    PerformanceBenchmark::PrintResults(result, "Add " + std::to_string(count) +
-                                                   " Orders");
+    Report(std::string{scenario.name},
+           PerformanceBenchmark::RunScenario(scenario, seed, operations));
   }
 
-  std::cout << "\n\n=== Mixed Operations Benchmark ===" << std::endl;
-  auto mixedResult = PerformanceBenchmark::BenchmarkMixedOperations(5000);
-  PerformanceBenchmark::PrintResults(mixedResult, "Mixed Operations (5000)");
+  if (!jsonPath.empty())
+    PerformanceBenchmark::WriteJson(jsonPath, seed, results);
+
+  // per stage spans of everything above, newest 64k per thread
+  if (!tracePath.empty()) {
+    std::cout << "\n\n=== Trace ===" << std::endl;
+    Trace::PrintSummary(std::cout);
+    Trace::WriteChromeTrace(tracePath);
+  }
 
   return 0;
 }
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Side.h"
+#include "Usings.h"
+
+// what uncrossing the book would do right now: the price that executes the
+// most quantity, how much, and what would be left unfilled on each side of it
+// (one of the two is always zero). A volume of zero means nothing crosses.
+struct AuctionIndication {
+  Price price_{};
+  std::uint64_t volume_{};
+  std::uint64_t buySurplus_{};
+  std::uint64_t sellSurplus_{};
+
+  // the side left with unfilled quantity at price_, the one pushing it
+  Side ImbalanceSide() const {
+    return sellSurplus_ > buySurplus_ ? Side::Sell : Side::Buy;
+  }
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Order.h"
+#include "OrderModify.h"
+#include "Trade.h"
+
+enum class CommandType : std::uint8_t {
+  Add,
+  Cancel,
+  Modify,
+  PruneGoodForDay,
+  Expire,
+  StartAuction,
+  Uncross,
+};
+
+// flat, trivially copyable request to change a book, what gateways push
+// through the command rings
+struct Command {
+  CommandType type_{CommandType::Add};
+  OrderType orderType_{OrderType::GoodTillCancel};
+  Side side_{Side::Buy};
+  OrderId orderId_{};
+  Price price_{};
+  Quantity quantity_{};
+  // book the command is routed to, a GFD prune or an expiry sweep covers
+  // every book it reaches
+  InstrumentId instrumentId_{};
+  // order expiry for adds, the sweep time for Expire
+  Timestamp expiry_{};
+  // trigger price of stop and stop limit adds
+  Price stopPrice_{};
+  // displayed peak of iceberg adds, zero for everything else
+  Quantity peak_{};
+
+  static Command Add(const Order &order, InstrumentId instrumentId = {}) {
+    return Command{CommandType::Add,        order.GetOrderType(),
+                   order.GetSide(),         order.GetOrderId(),
+                   order.GetPrice(),        order.GetInitialQuantity(),
+                   instrumentId,            order.GetExpiry(),
+                   order.GetStopPrice(),    order.GetPeakQuantity()};
+  }
+  static Command Cancel(OrderId orderId, InstrumentId instrumentId = {}) {
+    return Command{CommandType::Cancel, {}, {}, orderId, {}, {}, instrumentId};
+  }
+  static Command Modify(const OrderModify &modify,
+                        InstrumentId instrumentId = {}) {
+    return Command{CommandType::Modify, {},
+                   {},                  modify.GetOrderId(),
+                   modify.GetPrice(),   modify.GetQuantity(),
+                   instrumentId};
+  }
+  static Command PruneGoodForDay() {
+    return Command{CommandType::PruneGoodForDay};
+  }
+  // cancels at most maxOrders orders due at now, carrying the time rather than
+  // reading the clock keeps a journaled sweep replayable
+  static Command Expire(Timestamp now, Quantity maxOrders) {
+    return Command{CommandType::Expire, {}, {}, {}, {}, maxOrders, {}, now};
+  }
+
+  // call auction of one book: orders rest without matching from StartAuction
+  // until Uncross executes them at the equilibrium price
+  static Command StartAuction(InstrumentId instrumentId = {}) {
+    return Command{CommandType::StartAuction, {}, {}, {}, {}, {}, instrumentId};
+  }
+  static Command Uncross(InstrumentId instrumentId = {}) {
+    return Command{CommandType::Uncross, {}, {}, {}, {}, {}, instrumentId};
+  }
+
+  // false for an add that cannot become an order: a peak on a type that
+  // never rests. Cores reject these, books skip them, neither throws.
+  bool IsWellFormed() const {
+    return type_ != CommandType::Add || peak_ == 0 ||
+           Order::CanBeIceberg(orderType_);
+  }
+
+  Order ToOrder() const {
+    if (orderType_ == OrderType::Market)
+      return Order{orderId_, side_, quantity_};
+    if (orderType_ == OrderType::Stop)
+      return Order::Stop(orderId_, side_, stopPrice_, quantity_);
+    if (orderType_ == OrderType::StopLimit)
+      return Order::StopLimit(orderId_, side_, stopPrice_, price_, quantity_);
+    if (peak_ != 0)
+      return Order::Iceberg(orderType_, orderId_, side_, price_, quantity_,
+                            peak_, expiry_);
+    return Order{orderType_, orderId_, side_, price_, quantity_, expiry_};
+  }
+  OrderModify ToOrderModify() const {
+    return OrderModify{orderId_, price_, quantity_};
+  }
+};
+
+enum class ReportType : std::uint8_t {
+  Accepted,
+  Rejected,
+  Trade,
+};
+
+// what the matching core sends back to the gateway that issued a command,
+// bid/ask ids, price and quantity are only set for trades
+struct Report {
+  ReportType type_{ReportType::Accepted};
+  CommandType command_{CommandType::Add};
+  OrderId orderId_{};
+  OrderId bidId_{};
+  OrderId askId_{};
+  Price price_{};
+  Quantity quantity_{};
+  InstrumentId instrumentId_{};
+
+  static Report Accepted(const Command &command) {
+    return Report{ReportType::Accepted, command.type_, command.orderId_,
+                  {},                   {},            {},
+                  {},                   command.instrumentId_};
+  }
+  static Report Rejected(const Command &command) {
+    return Report{ReportType::Rejected, command.type_, command.orderId_,
+                  {},                   {},            {},
+                  {},                   command.instrumentId_};
+  }
+  static Report FromTrade(const Command &command, const Trade &trade) {
+    return Report{ReportType::Trade,    command.type_,
+                  command.orderId_,     trade.GetBidId(),
+                  trade.GetAskId(),     trade.GetPrice(),
+                  trade.GetQuantity(),  command.instrumentId_};
+  }
+};
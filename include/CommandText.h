@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "Command.h"
+
+// the text command format of the test fixtures, one command per line:
+//   A <GTC|GFD|FAK|FOK|M> <orderId> <B|S> <price> <quantity>
+//   M <orderId> <price> <quantity>
+//   C <orderId>
+// Fields are parsed in place off the line, nothing is allocated per line.
+// Anything else is a logic_error naming the line.
+Command ParseCommand(std::string_view line);
+
+// writes the commands of a text file to a new journal, the binary format
+// replays and captures use. Blank lines and the fixtures' R result line are
+// skipped. Returns how many commands were written.
+std::size_t ConvertTextToJournal(const std::string &textPath,
+                                 const std::string &journalPath,
+                                 InstrumentId instrumentId = {});
@@ -1,13 +1,23 @@
 #pragma once
 
 #include <chrono>
-#include <limits>
+#include <cstddef>
 
 #include "Usings.h"
 
 struct Constants {
-  static const Price InvalidPrice = std::numeric_limits<Price>::quiet_NaN();
   static constexpr auto EASTERN_OFFSET_EST = std::chrono::hours(-5);
   static constexpr auto EASTERN_OFFSET_EDT = std::chrono::hours(-4);
   static constexpr auto MARKET_CLOSE_HOUR = std::chrono::hours(16);
+  static constexpr std::size_t DEFAULT_ORDER_CAPACITY = 1 << 14;
+  // books on a MatchingCore start small, there may be thousands of them
+  static constexpr std::size_t DEFAULT_CORE_ORDER_CAPACITY = 1 << 8;
+  static constexpr std::size_t DEFAULT_LADDER_TICKS = 1 << 12;
+  static constexpr std::size_t DEFAULT_LADDER_MAX_TICKS = 1 << 18;
+  static constexpr std::size_t CACHE_LINE_SIZE = 64;
+  static constexpr std::size_t DEFAULT_RING_CAPACITY = 1 << 16;
+  static constexpr std::size_t DEFAULT_JOURNAL_BATCH = 1 << 10;
+  static constexpr std::size_t DEFAULT_EXPIRY_BATCH = 1 << 10;
+  // commands a busy matching core processes between checks for due expiries
+  static constexpr std::size_t EXPIRY_CHECK_INTERVAL = 1 << 6;
 };
\ No newline at end of file
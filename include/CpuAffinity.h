@@ -0,0 +1,39 @@
+#pragma once
+
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// pins a thread to one cpu, a no-op where affinity is not supported
+inline bool PinThread(std::thread &thread, int cpu) {
+#if defined(__linux__)
+  if (cpu < 0)
+    return false;
+
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  return pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus) ==
+         0;
+#else
+  (void)thread;
+  (void)cpu;
+  return false;
+#endif
+}
+
+// spin-wait hint for busy polling loops
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
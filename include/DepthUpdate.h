@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+#include "PriceLevelInfo.h"
+
+// top of book levels that changed after the sequence a consumer last saw. A
+// side comes whole (replaced) when one of its levels was removed meanwhile,
+// since levels further down may have moved up into view; otherwise only the
+// levels whose quantity changed are listed. Consumers keep their own image of
+// each side, apply the update and trim it back to the depth they asked for.
+struct DepthUpdate {
+  std::uint64_t sequence_{}; // pass back in on the next call
+  bool bidsReplaced_{};
+  bool asksReplaced_{};
+  PriceLevelInfos bids_;
+  PriceLevelInfos asks_;
+};
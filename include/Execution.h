@@ -0,0 +1,55 @@
+#pragma once
+
+#include <concepts>
+#include <memory>
+#include <type_traits>
+
+#include "Side.h"
+#include "Trade.h"
+#include "Usings.h"
+
+// one fill as the matching loop sees it, with what is left of both orders
+// after it and which side came in and took liquidity
+struct Execution {
+  OrderId bidId_;
+  OrderId askId_;
+  Price price_;
+  Quantity quantity_;
+  Side aggressor_;
+  Quantity bidRemaining_;
+  Quantity askRemaining_;
+};
+
+// non-owning reference to whatever handles fills, called once per fill while
+// the book is still matching. Two pointers, passed by value, never allocates:
+// a temporary callable lives as long as the call it is handed to, which is all
+// the sink needs. A Trades buffer converts implicitly, which is how the Trades
+// returning calls are built.
+class ExecutionSink {
+public:
+  template <typename Fn>
+    requires(!std::same_as<std::remove_cvref_t<Fn>, ExecutionSink> &&
+             std::invocable<Fn &, const Execution &>)
+  ExecutionSink(Fn &&fn)
+      : target_{const_cast<void *>(
+            static_cast<const void *>(std::addressof(fn)))},
+        invoke_{[](void *target, const Execution &execution) {
+          (*static_cast<std::remove_reference_t<Fn> *>(target))(execution);
+        }} {}
+
+  ExecutionSink(Trades &trades)
+      : target_{&trades}, invoke_{[](void *target,
+                                     const Execution &execution) {
+          static_cast<Trades *>(target)->emplace_back(
+              execution.bidId_, execution.askId_, execution.quantity_,
+              execution.price_);
+        }} {}
+
+  void operator()(const Execution &execution) const {
+    invoke_(target_, execution);
+  }
+
+private:
+  void *target_;
+  void (*invoke_)(void *, const Execution &);
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <memory_resource>
+#include <vector>
+
+#include "Usings.h"
+
+// orders that expire (GFD and GTD) bucketed by expiry time, so expiring never
+// has to look at orders that do not. Ids are not taken out when an order
+// leaves early, the book calls Retire and skips popped ids it no longer holds
+// at that expiry. Once stale ids outnumber live ones Compact drops them, so
+// the index stays within twice the expiring orders resting.
+class ExpiryIndex {
+public:
+  explicit ExpiryIndex(std::pmr::memory_resource *resource)
+      : buckets_{resource} {}
+
+  bool empty() const { return buckets_.empty(); }
+  // ids held, stale ones included
+  std::size_t size() const { return size_; }
+
+  void Add(Timestamp expiry, OrderId orderId) {
+    buckets_[expiry].push_back(orderId);
+    ++size_;
+    ++live_;
+  }
+
+  // an order added here has left the book, whether early or popped
+  void Retire() { --live_; }
+
+  bool IsMostlyStale() const {
+    const auto stale = size_ - live_;
+    return stale >= MinStale && stale > live_;
+  }
+
+  // keeps only the ids isLive(orderId, expiry) still holds
+  template <typename Fn> void Compact(Fn &&isLive) {
+    size_ = 0;
+    for (auto bucket = buckets_.begin(); bucket != buckets_.end();) {
+      auto &[expiry, orderIds] = *bucket;
+      std::erase_if(orderIds, [&isLive, expiry](OrderId orderId) {
+        return !isLive(orderId, expiry);
+      });
+      size_ += orderIds.size();
+      bucket = orderIds.empty() ? buckets_.erase(bucket) : std::next(bucket);
+    }
+  }
+
+  Timestamp NextExpiry() const {
+    return buckets_.empty() ? Timestamp::max() : buckets_.begin()->first;
+  }
+
+  // hands fn(orderId, expiry) at most max entries due at now, earliest first,
+  // and returns how many it handed out
+  template <typename Fn>
+  std::size_t PopDue(Timestamp now, std::size_t max, Fn &&fn) {
+    std::size_t popped{};
+    while (popped < max && !buckets_.empty() &&
+           buckets_.begin()->first <= now) {
+      auto &[expiry, orderIds] = *buckets_.begin();
+      while (popped < max && !orderIds.empty()) {
+        const auto orderId = orderIds.back();
+        orderIds.pop_back();
+        --size_;
+        ++popped;
+        fn(orderId, expiry);
+      }
+      if (orderIds.empty())
+        buckets_.erase(buckets_.begin());
+    }
+    return popped;
+  }
+
+  template <typename Fn> void ForEach(Fn &&fn) const {
+    for (const auto &[expiry, orderIds] : buckets_)
+      for (const auto orderId : orderIds)
+        fn(orderId, expiry);
+  }
+
+private:
+  // too few stale ids are not worth a walk of the index
+  static constexpr std::size_t MinStale = 64;
+
+  std::pmr::map<Timestamp, std::pmr::vector<OrderId>> buckets_;
+  std::size_t size_{};
+  std::size_t live_{};
+};
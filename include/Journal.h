@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Command.h"
+#include "Constants.h"
+#include "Execution.h"
+#include "MappedFile.h"
+
+// one command as stored on disk, fixed size and native endian
+struct JournalRecord {
+  std::uint64_t orderId_;
+  std::int64_t expiry_; // ns since the epoch
+  std::int32_t price_;
+  std::uint32_t quantity_;
+  std::uint32_t instrumentId_;
+  std::int32_t stopPrice_;
+  std::uint32_t peak_;
+  std::uint8_t type_;
+  std::uint8_t orderType_;
+  std::uint8_t side_;
+  std::uint8_t reserved_;
+
+  static JournalRecord FromCommand(const Command &command);
+  Command ToCommand() const;
+};
+
+static_assert(sizeof(JournalRecord) == 40);
+static_assert(std::is_trivially_copyable_v<JournalRecord>);
+
+struct JournalHeader {
+  static constexpr std::uint32_t Magic = 0x4a424f4f; // "OOBJ"
+  static constexpr std::uint16_t Version = 4;
+
+  std::uint32_t magic_{Magic};
+  std::uint16_t version_{Version};
+  std::uint16_t recordSize_{sizeof(JournalRecord)};
+  std::uint64_t reserved_{};
+
+  bool IsValid() const {
+    return magic_ == Magic && version_ == Version &&
+           recordSize_ == sizeof(JournalRecord);
+  }
+};
+
+static_assert(sizeof(JournalHeader) == 16);
+
+// write-ahead log of the commands a book processed. Appends collect in a
+// buffer that goes out in one write when it fills or on Flush(), Sync() also
+// waits for the data to reach the disk. Reopening a journal checks its header
+// and cuts off a record torn by a crash before appending.
+class JournalWriter {
+public:
+  explicit JournalWriter(const std::string &path,
+                         std::size_t batch = Constants::DEFAULT_JOURNAL_BATCH);
+  ~JournalWriter();
+
+  JournalWriter(const JournalWriter &) = delete;
+  JournalWriter &operator=(const JournalWriter &) = delete;
+
+  void Append(const Command &command);
+  void Flush();
+  void Sync();
+
+private:
+  void Write(const void *data, std::size_t size);
+
+  int fd_{-1};
+  std::vector<JournalRecord> buffer_;
+};
+
+// memory maps a journal for replay. A record torn by a crash at the tail is
+// ignored, replaying the rest gives the same book and the same trades.
+class JournalReader {
+public:
+  explicit JournalReader(const std::string &path);
+
+  std::span<const JournalRecord> Records() const { return records_; }
+
+  // feeds the commands for one instrument (and every GFD prune and expiry
+  // sweep) into book, returns how many. Orders expire only through the
+  // journaled commands, so books with an expiry thread are refused at compile
+  // time.
+  template <typename OrderbookType>
+    requires(!OrderbookType::RunsExpiryThread)
+  std::size_t Replay(OrderbookType &book, ExecutionSink executions,
+                     InstrumentId instrumentId = {}) const {
+    // converted a chunk at a time so the book still sees batches
+    constexpr std::size_t Chunk = 256;
+    Command commands[Chunk];
+    std::size_t count = 0;
+    std::size_t replayed = 0;
+
+    for (const auto &record : records_) {
+      const auto command = record.ToCommand();
+      if (command.instrumentId_ != instrumentId &&
+          command.type_ != CommandType::PruneGoodForDay &&
+          command.type_ != CommandType::Expire)
+        continue;
+
+      commands[count++] = command;
+      ++replayed;
+      if (count == Chunk) {
+        book.ProcessCommands(std::span{commands, count}, executions);
+        count = 0;
+      }
+    }
+    book.ProcessCommands(std::span{commands, count}, executions);
+    return replayed;
+  }
+
+private:
+  MappedFile file_;
+  std::span<const JournalRecord> records_;
+};
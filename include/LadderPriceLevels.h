@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "OrderbookOptions.h"
+#include "PriceLevel.h"
+#include "Side.h"
+#include "Usings.h"
+
+// one side of the book as a contiguous array of levels indexed by tick offset
+// from base_. A bitmap of occupied levels lets the best price cursor and
+// level iteration skip empty ticks a word at a time. Prices outside the
+// window move the base (empty side) or grow the array around the old levels,
+// never past maxTicks_.
+template <Side S> class LadderPriceLevels {
+public:
+  LadderPriceLevels(std::pmr::memory_resource *resource,
+                    const OrderbookOptions &options)
+      : levels_{resource}, occupied_{resource},
+        maxTicks_{RoundUp(std::max(options.ladderMaxTicks_,
+                                   options.ladderTicks_))} {
+    Resize(RoundUp(options.ladderTicks_));
+    if (options.ladderCenter_.has_value())
+      Recenter(options.ladderCenter_.value());
+    else
+      centred_ = false;
+  }
+
+  bool empty() const { return count_ == 0; }
+  std::size_t size() const { return count_; }
+
+  // whether a level at price fits: inside the window, or close enough to the
+  // resting levels that the side still spans at most maxTicks_
+  bool CanHold(Price price) const {
+    if (Contains(price) || empty())
+      return true;
+
+    const auto [low, high] = Span(price);
+    return CanSpan(low, high);
+  }
+  bool CanSpan(std::int64_t low, std::int64_t high) const {
+    return high - low < static_cast<std::int64_t>(maxTicks_);
+  }
+
+  // the price has to pass CanHold
+  PriceLevel &operator[](Price price) {
+    if (!Contains(price))
+      Reserve(price);
+
+    const auto index = Index(price);
+    if (!IsOccupied(index)) {
+      occupied_[index / WordBits] |= Bit(index);
+      if (count_++ == 0 || IsBetter(index, best_))
+        best_ = index;
+    }
+    return levels_[index];
+  }
+
+  PriceLevel &at(Price price) { return levels_[Index(price)]; }
+
+  void erase(Price price) {
+    const auto index = Index(price);
+    occupied_[index / WordBits] &= ~Bit(index);
+
+    if (--count_ != 0 && index == best_)
+      best_ = S == Side::Buy ? FindAtOrBelow(index) : FindAtOrAbove(index);
+  }
+
+  Price BestPrice() const { return ToPrice(best_); }
+  PriceLevel &Best() { return levels_[best_]; }
+  Price WorstPrice() const {
+    return ToPrice(S == Side::Buy ? FindAtOrAbove(0)
+                                  : FindAtOrBelow(levels_.size() - 1));
+  }
+
+  // visits levels best first, stops early if fn returns false
+  template <typename Fn> void ForEach(Fn &&fn) const {
+    if (empty())
+      return;
+
+    for (auto index = best_; index != npos; index = NextWorse(index)) {
+      if constexpr (std::is_same_v<std::invoke_result_t<Fn &, Price,
+                                                        const PriceLevel &>,
+                                   bool>) {
+        if (!fn(ToPrice(index), levels_[index]))
+          return;
+      } else
+        fn(ToPrice(index), levels_[index]);
+    }
+  }
+
+private:
+  static constexpr std::size_t WordBits = 64;
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  static std::size_t RoundUp(std::size_t ticks) {
+    return std::max<std::size_t>((ticks + WordBits - 1) / WordBits, 1) *
+           WordBits;
+  }
+  static std::uint64_t Bit(std::size_t index) {
+    return std::uint64_t{1} << (index % WordBits);
+  }
+
+  bool Contains(Price price) const {
+    return centred_ && price >= base_ &&
+           static_cast<std::int64_t>(price) - base_ <
+               static_cast<std::int64_t>(levels_.size());
+  }
+  std::size_t Index(Price price) const {
+    return static_cast<std::size_t>(static_cast<std::int64_t>(price) - base_);
+  }
+  Price ToPrice(std::size_t index) const {
+    return static_cast<Price>(base_ + static_cast<std::int64_t>(index));
+  }
+  bool IsOccupied(std::size_t index) const {
+    return occupied_[index / WordBits] & Bit(index);
+  }
+  bool IsBetter(std::size_t index, std::size_t than) const {
+    return S == Side::Buy ? index > than : index < than;
+  }
+  std::size_t NextWorse(std::size_t index) const {
+    if constexpr (S == Side::Buy)
+      return index == 0 ? npos : FindAtOrBelow(index - 1);
+    else
+      return FindAtOrAbove(index + 1);
+  }
+
+  // highest occupied index <= from, or npos
+  std::size_t FindAtOrBelow(std::size_t from) const {
+    auto word = from / WordBits;
+    auto bits = occupied_[word] & (~std::uint64_t{0} >>
+                                   (WordBits - 1 - from % WordBits));
+    while (true) {
+      if (bits)
+        return word * WordBits + WordBits - 1 - std::countl_zero(bits);
+      if (word == 0)
+        return npos;
+      bits = occupied_[--word];
+    }
+  }
+
+  // lowest occupied index >= from, or npos
+  std::size_t FindAtOrAbove(std::size_t from) const {
+    auto word = from / WordBits;
+    if (word >= occupied_.size())
+      return npos;
+
+    auto bits = occupied_[word] & (~std::uint64_t{0} << (from % WordBits));
+    while (true) {
+      if (bits)
+        return word * WordBits + std::countr_zero(bits);
+      if (++word == occupied_.size())
+        return npos;
+      bits = occupied_[word];
+    }
+  }
+
+  void Resize(std::size_t ticks) {
+    levels_.clear();
+    levels_.resize(ticks);
+    occupied_.assign(ticks / WordBits, 0);
+  }
+
+  void Recenter(Price price) {
+    base_ = static_cast<Price>(static_cast<std::int64_t>(price) -
+                               static_cast<std::int64_t>(levels_.size() / 2));
+    centred_ = true;
+  }
+
+  // lowest and highest price of the resting levels and price together
+  std::pair<std::int64_t, std::int64_t> Span(Price price) const {
+    return {std::min<std::int64_t>(price, ToPrice(FindAtOrAbove(0))),
+            std::max<std::int64_t>(
+                price, ToPrice(FindAtOrBelow(levels_.size() - 1)))};
+  }
+
+  // makes room for a price outside the window. An empty ladder just moves its
+  // base, otherwise the array doubles until it spans both the resting levels
+  // and the new price, keeping the spare ticks on the side it grew towards.
+  // Growth stops at maxTicks_, CanHold has kept the span within it.
+  void Reserve(Price price) {
+    if (empty()) {
+      Recenter(price);
+      return;
+    }
+
+    const auto [low, high] = Span(price);
+
+    auto ticks = levels_.size();
+    while (static_cast<std::int64_t>(ticks) < 2 * (high - low + 1))
+      ticks *= 2;
+    ticks = std::min(ticks, maxTicks_);
+
+    const std::int64_t base =
+        price < base_ ? high - static_cast<std::int64_t>(ticks) + 1 : low;
+
+    std::pmr::vector<PriceLevel> levels{levels_.get_allocator()};
+    levels.resize(ticks);
+    std::pmr::vector<std::uint64_t> occupied(ticks / WordBits, 0,
+                                             occupied_.get_allocator());
+
+    for (auto index = FindAtOrAbove(0); index != npos;
+         index = FindAtOrAbove(index + 1)) {
+      const auto moved = static_cast<std::size_t>(ToPrice(index) - base);
+      levels[moved] = std::move(levels_[index]);
+      occupied[moved / WordBits] |= Bit(moved);
+    }
+
+    best_ = static_cast<std::size_t>(ToPrice(best_) - base);
+    base_ = static_cast<Price>(base);
+    levels_ = std::move(levels);
+    occupied_ = std::move(occupied);
+  }
+
+  std::pmr::vector<PriceLevel> levels_;
+  std::pmr::vector<std::uint64_t> occupied_;
+  const std::size_t maxTicks_;
+  Price base_{};
+  bool centred_{true};
+  std::size_t best_{};
+  std::size_t count_{};
+};
+
+struct LadderLevels {
+  template <Side S> using Levels = LadderPriceLevels<S>;
+};
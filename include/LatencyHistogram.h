@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// log-linear histogram in the spirit of HdrHistogram. Values below 128 get a
+// bucket each, every power of two above that is split into 64 buckets, so a
+// reported percentile is within 1/64 (~1.6%) of the recorded value at any
+// magnitude. Recording is a couple of bit operations and an increment.
+class LatencyHistogram {
+public:
+  void Record(std::uint64_t value) {
+    ++buckets_[Index(value)];
+    ++count_;
+    sum_ += value;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  void Merge(const LatencyHistogram &other) {
+    for (std::size_t i = 0; i < buckets_.size(); ++i)
+      buckets_[i] += other.buckets_[i];
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+
+  // highest value equivalent to the recorded one at the given rank, 0..100
+  std::uint64_t Percentile(double percentile) const {
+    if (count_ == 0)
+      return 0;
+
+    // rounded rather than ceiled, so 99.9 of 1e5 is rank 99900 whichever
+    // way the multiplication rounds
+    const auto rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(std::llround(
+               percentile / 100.0 * static_cast<double>(count_))));
+
+    std::uint64_t seen{};
+    for (std::size_t i = 0; i < buckets_.size(); ++i) {
+      seen += buckets_[i];
+      if (seen >= rank)
+        return std::min(HighestEquivalent(i), max_);
+    }
+    return max_;
+  }
+
+  std::uint64_t Count() const { return count_; }
+  std::uint64_t Min() const { return count_ ? min_ : 0; }
+  std::uint64_t Max() const { return max_; }
+  double Mean() const {
+    return count_ ? static_cast<double>(sum_) / static_cast<double>(count_)
+                  : 0.0;
+  }
+
+private:
+  static constexpr std::size_t SubBuckets = 64;
+  static constexpr std::size_t LinearLimit = 2 * SubBuckets;
+  static constexpr std::size_t BucketCount =
+      (64 - std::bit_width(LinearLimit - 1) + 2) * SubBuckets;
+
+  static std::size_t Index(std::uint64_t value) {
+    if (value < LinearLimit)
+      return static_cast<std::size_t>(value);
+
+    // shift keeps the top 7 bits, i.e. a sub bucket in [64, 128)
+    const auto shift = std::bit_width(value) - std::bit_width(LinearLimit - 1);
+    return shift * SubBuckets + static_cast<std::size_t>(value >> shift);
+  }
+
+  static std::uint64_t HighestEquivalent(std::size_t index) {
+    if (index < LinearLimit)
+      return index;
+
+    const auto shift = index / SubBuckets - 1;
+    const auto subBucket = index - shift * SubBuckets;
+    return ((static_cast<std::uint64_t>(subBucket) + 1) << shift) - 1;
+  }
+
+  std::array<std::uint64_t, BucketCount> buckets_{};
+  std::uint64_t count_{};
+  std::uint64_t sum_{};
+  std::uint64_t min_{std::numeric_limits<std::uint64_t>::max()};
+  std::uint64_t max_{};
+};
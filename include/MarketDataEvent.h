@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Side.h"
+#include "Usings.h"
+
+enum class MarketDataEventType : std::uint8_t {
+  // L2, quantity_ is the level's total after the change
+  LevelAdd,
+  LevelChange,
+  LevelDelete,
+  // L3, quantity_ is what the event added to or took off the order
+  OrderAdd,
+  OrderExecute,
+  OrderCancel, // a partial cancel leaves the rest of the order resting
+  // call auction, price_ and quantity_ are the indicative uncross price and
+  // volume, side_ the side with the surplus
+  AuctionIndication,
+};
+
+// fixed size book change as published from the matching path. sequence_ is
+// contiguous per book, so a jump tells a consumer events were dropped.
+struct MarketDataEvent {
+  std::uint64_t sequence_{};
+  OrderId orderId_{}; // L3 only
+  Price price_{};
+  Quantity quantity_{};
+  MarketDataEventType type_{};
+  Side side_{};
+};
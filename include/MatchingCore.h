@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Command.h"
+#include "Journal.h"
+#include "OrderBook.h"
+#include "SpscRing.h"
+
+struct MatchingCoreOptions {
+  // one command ring and one report ring per gateway thread
+  std::size_t gateways_{1};
+  std::size_t ringCapacity_{Constants::DEFAULT_RING_CAPACITY};
+  // cpu the matching thread is pinned to, negative leaves it unpinned
+  int cpu_{-1};
+  // one book per instrument, commands for any other instrument are rejected
+  std::vector<InstrumentId> instruments_{InstrumentId{}};
+  // journal every command that reaches a book to this file, empty for none
+  std::string journal_{};
+  // options for every book, which grows its pool and id table past
+  // orderCapacity_ on demand
+  OrderbookOptions book_{.orderCapacity_ =
+                             Constants::DEFAULT_CORE_ORDER_CAPACITY};
+  // tick size per instrument, the ones not listed use book_.tickSize_
+  std::unordered_map<InstrumentId, Price> tickSizes_{};
+};
+
+// owns one Orderbook per instrument on a dedicated thread. Gateway threads push
+// commands into their own SPSC ring and read acks, rejects and trades back from
+// their own report ring, so the books run single writer and never take a lock.
+// A trade is reported to the gateway that sent the command and to the gateways
+// that own the resting orders it filled.
+// GFD pruning is just another command (Command::PruneGoodForDay) and covers
+// every book on the core, due GFD/GTD orders are expired while it is idle and
+// every Constants::EXPIRY_CHECK_INTERVAL commands while it is busy.
+class MatchingCore {
+public:
+  explicit MatchingCore(const MatchingCoreOptions &options = {});
+  ~MatchingCore();
+
+  MatchingCore(const MatchingCore &) = delete;
+  MatchingCore &operator=(const MatchingCore &) = delete;
+
+  // gateway side, each gateway index must only be used from one thread
+  bool Submit(std::size_t gateway, const Command &command);
+  bool Poll(std::size_t gateway, Report &report);
+
+  void Stop();
+
+private:
+  struct Gateway {
+    explicit Gateway(std::size_t capacity)
+        : commands_{capacity}, reports_{capacity} {}
+
+    SpscRing<Command> commands_;
+    SpscRing<Report> reports_;
+  };
+
+  struct Book {
+    std::unique_ptr<SingleWriterOrderbook> orders_;
+    // gateway of every order resting or pending on the book
+    std::unordered_map<OrderId, std::size_t> owners_;
+  };
+
+  void Run();
+  void Process(std::size_t gateway, const Command &request);
+  void PublishTrades(std::size_t gateway, const Command &command, Book &book);
+  static void ForgetGone(Book &book);
+  void Expire(Timestamp now);
+  void Publish(Gateway &gateway, const Report &report);
+
+  // owned by the core thread alone, built without a mutex or an expiry thread
+  std::unordered_map<InstrumentId, Book> books_;
+  std::vector<std::unique_ptr<Gateway>> gateways_;
+  std::unique_ptr<JournalWriter> journal_;
+  const TradingSession session_;
+  const std::size_t expiryBatch_;
+  Timestamp nextExpiry_{Timestamp::max()};
+  Trades trades_;
+  std::atomic<bool> running_{true};
+  std::thread thread_; // started last, after what it runs on
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "MatchingCore.h"
+
+struct MatchingEngineOptions {
+  // worker threads the books are sharded across, fixed for the engine's life
+  std::size_t workers_{1};
+  std::size_t gateways_{1};
+  std::size_t ringCapacity_{Constants::DEFAULT_RING_CAPACITY};
+  // cpu for each worker by index, workers past the end are left unpinned
+  std::vector<int> cpus_{};
+  // options for every book, which grows its pool and id table past
+  // orderCapacity_ on demand
+  OrderbookOptions book_{.orderCapacity_ =
+                             Constants::DEFAULT_CORE_ORDER_CAPACITY};
+  // tick size per instrument, the ones not listed use book_.tickSize_
+  std::unordered_map<InstrumentId, Price> tickSizes_{};
+};
+
+// many books, one per instrument, sharded across a fixed set of MatchingCores.
+// An instrument always lives on worker instrumentId % workers, so commands are
+// routed by symbol and a book costs no thread of its own. Each worker expires
+// its own GFD and GTD orders as they come due, journaled as Expire commands.
+class MatchingEngine {
+public:
+  explicit MatchingEngine(std::span<const InstrumentId> instruments,
+                          const MatchingEngineOptions &options = {});
+  ~MatchingEngine();
+
+  MatchingEngine(const MatchingEngine &) = delete;
+  MatchingEngine &operator=(const MatchingEngine &) = delete;
+
+  // gateway side, each gateway index must only be used from one thread.
+  // Reports carry the instrument, their order is only kept per instrument.
+  bool Submit(std::size_t gateway, const Command &command);
+  bool Poll(std::size_t gateway, Report &report);
+
+  // cancels every GFD order on every book now, ahead of its close, and
+  // returns once all workers are done. Not to be called during Stop.
+  void PruneGoodForDay();
+
+  std::size_t Workers() const;
+  std::size_t WorkerOf(InstrumentId instrumentId) const;
+
+  void Stop();
+
+private:
+  struct alignas(Constants::CACHE_LINE_SIZE) PollCursor {
+    std::size_t next_{};
+  };
+
+  std::vector<std::unique_ptr<MatchingCore>> workers_;
+  std::vector<PollCursor> pollCursors_;
+  // extra gateway on every worker that only PruneGoodForDay uses, one caller
+  // at a time as its rings are single producer
+  std::size_t pruneGateway_;
+  std::mutex pruneMutex_;
+};
@@ -1,9 +1,5 @@
 #pragma once
 
-#include <list>
-#include <memory>
-
-#include "Constants.h"
 #include "OrderType.h"
 #include "Side.h"
 #include "Usings.h"
@@ -12,33 +8,102 @@ class Order {
 public:
   Order(OrderType orderType, OrderId orderId, Side side, Price price,
         Quantity quantity)
-      : orderType_{orderType}, orderId_{orderId}, side_{side}, price_{price},
-        initialQuantity_{quantity}, remainingQuantity_{quantity} {}
+      : orderId_{orderId}, price_{price}, remainingQuantity_{quantity},
+        side_{side}, orderType_{orderType}, initialQuantity_{quantity} {}
+
+  // GoodTillDate orders carry their own expiry, GoodForDay ones are given the
+  // session close by the book unless they already have one
+  Order(OrderType orderType, OrderId orderId, Side side, Price price,
+        Quantity quantity, Timestamp expiry)
+      : Order(orderType, orderId, side, price, quantity) {
+    expiry_ = expiry;
+  }
 
+  // a market order has no price of its own, the book gives it one when it
+  // turns it into a FAK against the far side (see ToFillAndKill)
   Order(OrderId orderId, Side side, Quantity quantity)
-      : Order(OrderType::Market, orderId, side, Constants::InvalidPrice,
-              quantity) {}
+      : Order(OrderType::Market, orderId, side, Price{}, quantity) {}
+
+  // stops wait in the book's trigger book until a trade prints at stopPrice
+  // or beyond, then enter as a market order (Stop) or as a GTC limit order at
+  // price (StopLimit), see Triggered
+  static Order Stop(OrderId orderId, Side side, Price stopPrice,
+                    Quantity quantity) {
+    Order order{OrderType::Stop, orderId, side, Price{}, quantity};
+    order.stopPrice_ = stopPrice;
+    return order;
+  }
+  static Order StopLimit(OrderId orderId, Side side, Price stopPrice,
+                         Price price, Quantity quantity) {
+    Order order{OrderType::StopLimit, orderId, side, price, quantity};
+    order.stopPrice_ = stopPrice;
+    return order;
+  }
+
+  // an iceberg shows at most peak at a time, the rest of quantity waits in
+  // reserve and is shown peak by peak as each one fills, see Replenish. Only
+  // orders that rest can be icebergs.
+  static Order Iceberg(OrderType orderType, OrderId orderId, Side side,
+                       Price price, Quantity quantity, Quantity peak,
+                       Timestamp expiry = {});
+  static bool CanBeIceberg(OrderType orderType) {
+    return orderType == OrderType::GoodTillCancel ||
+           orderType == OrderType::GoodForDay ||
+           orderType == OrderType::GoodTillDate;
+  }
 
   OrderId GetOrderId() const { return orderId_; }
   Side GetSide() const { return side_; }
   Price GetPrice() const { return price_; }
   OrderType GetOrderType() const { return orderType_; }
   Quantity GetInitialQuantity() const { return initialQuantity_; }
+  // what is displayed, all there is to match against until the next peak
   Quantity GetRemainingQuantity() const { return remainingQuantity_; }
+  Quantity GetHiddenQuantity() const { return hiddenQuantity_; }
+  Quantity GetOpenQuantity() const {
+    return remainingQuantity_ + hiddenQuantity_;
+  }
+  Quantity GetPeakQuantity() const { return peakQuantity_; }
+  bool HasReserve() const { return hiddenQuantity_ != 0; }
+  // nothing displayed left: the order is filled, or an iceberg is due its
+  // next peak
+  bool IsDepleted() const { return remainingQuantity_ == 0; }
+  void Replenish();
+  void Restore(Quantity displayed, Quantity hidden);
+  Timestamp GetExpiry() const { return expiry_; }
+  bool HasExpiry() const {
+    return orderType_ == OrderType::GoodForDay ||
+           orderType_ == OrderType::GoodTillDate;
+  }
+  void SetExpiry(Timestamp expiry) { expiry_ = expiry; }
+  Price GetStopPrice() const { return stopPrice_; }
+  bool IsStop() const {
+    return orderType_ == OrderType::Stop || orderType_ == OrderType::StopLimit;
+  }
+  Order Triggered() const;
   Quantity GetFilledQuantity() const;
   bool IsFilled() const;
   void Fill(Quantity quantity);
+  void ReduceQuantity(Quantity quantity);
+  void Replace(Price price, Quantity quantity);
 	void ToFillAndKill(Price price);
 
 private:
-  OrderType orderType_;
+  // hot: what a fill reads and writes, the intrusive links into the FIFO of
+  // the price level the order rests at first, all within the first 34 bytes
+  friend class OrderList;
+  Order *prev_{nullptr};
+  Order *next_{nullptr};
   OrderId orderId_;
-  Side side_;
   Price price_;
-  Quantity initialQuantity_;
   Quantity remainingQuantity_;
-};
+  Side side_;
+  OrderType orderType_;
 
-using OrderPointer = std::shared_ptr<Order>;
-using OrderPointers = std::list<OrderPointer>;
-// look into using vector + flag for better performance
+  // cold: only read when the order is added, modified, expired or saved
+  Quantity initialQuantity_;
+  Timestamp expiry_{};
+  Price stopPrice_{};
+  Quantity peakQuantity_{}; // icebergs only
+  Quantity hiddenQuantity_{};
+};
@@ -1,70 +1,241 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
-#include <map>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <thread>
-#include <unordered_map>
+#include <type_traits>
 
+#include "AuctionIndication.h"
+#include "Command.h"
+#include "DepthUpdate.h"
+#include "Execution.h"
+#include "ExpiryIndex.h"
+#include "LadderPriceLevels.h"
 #include "Order.h"
+#include "OrderList.h"
 #include "OrderModify.h"
+#include "OrderPool.h"
+#include "OrderTable.h"
+#include "OrderbookOptions.h"
+#include "OrderbookPolicies.h"
 #include "OrderbookPriceLevelInfos.h"
+#include "Snapshot.h"
+#include "TickSize.h"
 #include "Trade.h"
+#include "TreePriceLevels.h"
+#include "TriggerBook.h"
 #include "Usings.h"
 
-class Orderbook {
+// Policies is an OrderbookPolicies (see OrderbookPolicies.h): LevelPolicy
+// picks how each side stores its price levels, TreeLevels (a map keyed by
+// price) or LadderLevels (an array indexed by tick offset), LockPolicy and
+// ExpiryPolicy what guards the book and what expires its orders. NoLock drops
+// the mutex and ExternalExpiry or NoExpiry the expiry thread at compile time;
+// OptionsLock still picks locked or not at run time from the options. The
+// order type is still dispatched at run time, per order.
+template <typename Policies> class BasicOrderbook {
+  using LevelPolicy = typename Policies::LevelPolicy;
+  using LockPolicy = typename Policies::LockPolicy;
+  using ExpiryPolicy = typename Policies::ExpiryPolicy;
+
 public:
-  Orderbook();
-  ~Orderbook();
+  // whether a background thread may cancel orders on its own clock, what a
+  // deterministic replay has to rule out
+  static constexpr bool RunsExpiryThread = ExpiryPolicy::RunsThread;
+
+  explicit BasicOrderbook(const OrderbookOptions &options = {});
+  ~BasicOrderbook();
 
-  Trades AddOrder(OrderPointer order);
+  Trades AddOrder(const Order &order);
   void CancelOrder(OrderId orderId);
   Trades ModifyOrder(const OrderModify &order);
 
+  // fills are handed to executions as they happen instead of being collected,
+  // a call that trades nothing allocates nothing
+  void AddOrder(const Order &order, ExecutionSink executions);
+  void ModifyOrder(const OrderModify &order, ExecutionSink executions);
+  void CancelGoodForDayOrders();
+
+  // cancels at most maxOrders GFD/GTD orders due at now and returns how many
+  // expiry entries it went through, a full batch means more may be due
+  std::size_t CancelExpiredOrders(Timestamp now, std::size_t maxOrders);
+  Timestamp NextExpiry() const;
+
+  // batch entry: one lock acquisition for the whole span. Passing a Trades
+  // buffer appends to it, so it can be cleared and reused between batches.
+  void AddOrders(std::span<const Order> orders, ExecutionSink executions);
+  void CancelOrders(std::span<const OrderId> orderIds);
+  void ModifyOrders(std::span<const OrderModify> orders,
+                    ExecutionSink executions);
+  void ProcessCommands(std::span<const Command> commands,
+                       ExecutionSink executions);
+
+  // call auction: from StartAuction() orders rest without matching, even
+  // through each other, and Uncross() executes every order that crosses at the
+  // single price that fills the most quantity, then goes back to continuous
+  // matching. FAK, FOK and market orders are refused during the auction and
+  // stops stay pending until the uncross.
+  void StartAuction();
+  bool InAuction() const;
+  Trades Uncross();
+  void Uncross(ExecutionSink executions);
+  // computes the indicative uncross and publishes it as market data. One
+  // linear walk of the crossed levels, so it is meant to be called on a timer
+  // rather than after every order.
+  AuctionIndication PublishIndicativeUncross();
+
+  bool Contains(OrderId orderId) const;
   std::size_t Size() const;
+  std::uint64_t DroppedMarketData() const;
   OrderbookPriceLevelInfos GetOrderInfos() const;
 
+  // market data reads of the maintained level quantities, O(levels) per call
+  OrderbookPriceLevelInfos GetDepth(std::size_t levels) const;
+  DepthUpdate GetDepthUpdate(std::size_t levels, std::uint64_t sequence) const;
+
+  // snapshots: Snapshot() copies every resting order and pending stop under
+  // the lock, so matching pauses for O(orders), 48 bytes an order, but does
+  // no I/O; WriteSnapshot() can then run on any thread. Restore() loads one
+  // into an empty book without matching, typically straight out of a
+  // SnapshotReader's mapping. Every record is checked before the book is
+  // touched, a bad one throws and leaves the book empty. A crossed snapshot,
+  // taken during a call auction, only restores into a book that is in one.
+  // The last trade price is not kept, restored stops wait for the next trade.
+  SnapshotOrders Snapshot() const;
+  void Restore(std::span<const SnapshotOrder> orders);
+
 private:
-  // representation of order and location in orderbook
-  struct OrderEntry {
-    OrderPointer order_{nullptr};
-    OrderPointers::iterator location_;
+  // for book-keeping of the per level aggregates
+  enum class LevelAction {
+    Add,
+    Remove,
+    Match, // quantity leaves the level but the order stays
   };
 
-  // for book-keeping
-  struct LevelData {
-    Quantity quantity_{};
-    Quantity count_{};
+  // orders live in pool_ and are linked into their level's OrderList, the
+  // containers below draw their memory from resource_ which recycles it
+  OrderPool pool_;
+  std::pmr::unsynchronized_pool_resource resource_;
+
+  // each PriceLevel carries its own remaining quantity, the side totals let a
+  // FOK that the whole side cannot cover be rejected without a walk
+  typename LevelPolicy::template Levels<Side::Buy> bids_;
+  typename LevelPolicy::template Levels<Side::Sell> asks_;
+  std::uint64_t bidQuantity_{};
+  std::uint64_t askQuantity_{};
+
+  // bumped on every level change, and remembered per side whenever a level
+  // empties, so depth consumers can ask what changed since they last looked
+  std::uint64_t depthSequence_{};
+  std::uint64_t bidRemovedSequence_{};
+  std::uint64_t askRemovedSequence_{};
+
+  SpscRing<MarketDataEvent> *const marketData_;
+  std::uint64_t marketDataSequence_{};
+  std::uint64_t marketDataDropped_{};
+  OrderTable orders_;
 
-    enum class Action {
-      Add,
-      Remove,
-      Match,
-    };
+  // GFD and GTD orders by expiry, GFD ones expire at the session's next close
+  struct NoExpiryIndex {
+    explicit NoExpiryIndex(std::pmr::memory_resource *) {}
   };
+  [[no_unique_address]] std::conditional_t<ExpiryPolicy::TracksExpiry,
+                                           ExpiryIndex, NoExpiryIndex>
+      expiries_{&resource_};
+  const Price tickSize_;
 
-  // no need to specify side for data_ because guaranteed to have bids lower
-  // than asks if they exist, otherwise it wouldve been matched already
-  std::unordered_map<Price, LevelData> data_;
-  std::map<Price, OrderPointers, std::greater<Price>> bids_;
-  std::map<Price, OrderPointers, std::less<Price>> asks_;
-  std::unordered_map<OrderId, OrderEntry> orders_;
-  mutable std::mutex ordersMutex_;
-  std::thread ordersPruneThread_;
-  std::condition_variable shutdownConditionVariable_;
-  std::atomic<bool> shutdown_{false};
+  // stop and stop limit orders not triggered yet, in orders_ but in no level.
+  // Fired by the price of the last trade, and released one at a time so a
+  // cascade of stops resolves within the call that started it.
+  TriggerBook stops_{&resource_};
+  std::optional<Price> lastTradePrice_;
+  bool releasingStops_{false};
+  bool inAuction_{false};
+  // resting icebergs, while there are none the level totals are all the
+  // quantity there is and an auction can price off them alone
+  std::size_t icebergs_{};
 
-  void PruneGoodForDayOrders();
+  const TradingSession session_;
+  const std::size_t expiryBatch_;
 
-  void CancelOrders(const OrderIds &orderIds);
+  [[no_unique_address]] LockPolicy lock_;
+
+  // what the expiry thread waits on, only there if ExpiryPolicy runs one
+  struct ExpiryWorker {
+    std::condition_variable wake_;
+    std::atomic<bool> shutdown_{false};
+    std::thread thread_; // started last, after what it waits on
+  };
+  struct NoExpiryWorker {};
+  [[no_unique_address]] std::conditional_t<ExpiryPolicy::RunsThread,
+                                           ExpiryWorker, NoExpiryWorker>
+      expiryWorker_;
+
+  // the guard of LockPolicy, held for the length of a public call
+  auto LockOrders() const { return lock_.Lock(); }
+
+  void PruneExpiredOrders();
+
+  void AddOrderInternal(const Order &order, ExecutionSink executions);
+  void AddTransientOrder(const Order &order, ExecutionSink executions);
+  void AddStopOrder(const Order &order, ExecutionSink executions);
+  void ReleaseStops(ExecutionSink executions);
   void CancelOrderInternal(OrderId orderId);
+  void RemoveFromLevel(Order *order);
+  void ModifyOrderInternal(const OrderModify &order,
+                           ExecutionSink executions);
+  void CancelGoodForDayOrdersInternal();
+  std::size_t CancelExpiredOrdersInternal(Timestamp now, std::size_t maxOrders);
+  // expiry index upkeep, no-ops for a book without one
+  bool HoldsExpiry(OrderId orderId, Timestamp expiry) const;
+  void AddExpiry(const Order *order);
+  void RetireExpiry(const Order *order);
 
+  AuctionIndication ComputeUncross() const;
+  void UncrossInternal(ExecutionSink executions);
+
+  // throws on the first record Restore could not load
+  void ValidateSnapshot(std::span<const SnapshotOrder> orders) const;
+  bool CanHold(Side side, Price price) const {
+    return side == Side::Buy ? bids_.CanHold(price) : asks_.CanHold(price);
+  }
   bool CanMatch(Side side, Price price) const;
   bool CanFullyFill(Side side, Price price, Quantity) const;
-  Trades MatchOrders();
-
-  void OnOrderCancelled(OrderPointer order);
-  void OnOrderAdded(OrderPointer order);
-  void OnOrderMatched(Price price, Quantity quantity, bool isFullyFilled);
-  void UpdateLevelData(Price price, Quantity quantity,
-                       LevelData::Action action);
-};
\ No newline at end of file
+  void MatchOrders(Side aggressor, ExecutionSink executions);
+  template <typename Levels>
+  void MatchTransient(Order &incoming, Levels &levels,
+                      ExecutionSink executions);
+  // fills incoming against every order at level, returns the quantity taken
+  Quantity SweepLevel(Order &incoming, PriceLevel &level,
+                      ExecutionSink executions);
+  void Execute(Order &incoming, Order &resting, Quantity quantity,
+               ExecutionSink executions);
+  // takes the depleted front order off level, requeueing an iceberg with
+  // reserve at the back instead of letting it go
+  void RetireFront(PriceLevel &level);
+
+  void OnOrderCancelled(const Order *order, PriceLevel &level);
+  void OnOrderAdded(const Order *order, PriceLevel &level);
+  void OnOrderMatched(const Order *order, PriceLevel &level,
+                      Quantity quantity);
+  void OnOrderReduced(const Order *order, PriceLevel &level,
+                      Quantity quantity);
+  void UpdateLevelData(const Order *order, PriceLevel &level,
+                       Quantity quantity, LevelAction action);
+  void PublishMarketData(MarketDataEventType type, const Order *order,
+                         Quantity quantity);
+};
+
+using Orderbook = BasicOrderbook<OrderbookPolicies<TreeLevels>>;
+using LadderOrderbook = BasicOrderbook<OrderbookPolicies<LadderLevels>>;
+
+// one book per pinned core: no mutex, no thread, expiry driven by the owner
+using SingleWriterOrderbook =
+    BasicOrderbook<OrderbookPolicies<TreeLevels, NoLock, ExternalExpiry>>;
+using SingleWriterLadderOrderbook =
+    BasicOrderbook<OrderbookPolicies<LadderLevels, NoLock, ExternalExpiry>>;
+
+#include "OrderBook.ipp"
@@ -0,0 +1,1229 @@
+// definitions of BasicOrderbook, included at the end of OrderBook.h so a book
+// of any policy combination can be built and its hot path inlined into the
+// caller. Not meant to be included on its own.
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Trace.h"
+
+template <typename Policies>
+BasicOrderbook<Policies>::BasicOrderbook(const OrderbookOptions &options)
+    : pool_{options.orderCapacity_}, bids_{&resource_, options},
+      asks_{&resource_, options}, marketData_{options.marketData_},
+      orders_{&resource_, options.orderCapacity_},
+      tickSize_{std::max<Price>(options.tickSize_, 1)},
+      session_{options.session_},
+      expiryBatch_{std::max<std::size_t>(options.expiryBatch_, 1)},
+      lock_{options} {
+  if constexpr (ExpiryPolicy::RunsThread)
+    if (lock_.IsLocked())
+      expiryWorker_.thread_ = std::thread{[this]() { PruneExpiredOrders(); }};
+}
+
+template <typename Policies>
+BasicOrderbook<Policies>::~BasicOrderbook() {
+  if constexpr (ExpiryPolicy::RunsThread) {
+    // ensures proper cleaning up of the thread on shutdown, the flag is set
+    // under the lock so the notify cannot slip in before the thread waits
+    {
+      std::scoped_lock shutdownLock{lock_.Mutex()};
+      // done with my writes
+      expiryWorker_.shutdown_.store(true, std::memory_order_release);
+    }
+    expiryWorker_.wake_.notify_one(); // signals to wait_for to wake up
+    if (expiryWorker_.thread_.joinable())
+      expiryWorker_.thread_.join();
+  }
+}
+
+template <typename Policies>
+Trades BasicOrderbook<Policies>::AddOrder(const Order &order) {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+
+  Trades trades;
+  AddOrderInternal(order, trades);
+  return trades;
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::AddOrder(const Order &order,
+                                        ExecutionSink executions) {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+  AddOrderInternal(order, executions);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::AddOrders(std::span<const Order> orders,
+                                         ExecutionSink executions) {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+
+  for (const auto &order : orders)
+    AddOrderInternal(order, executions);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::AddOrderInternal(const Order &request,
+                                                ExecutionSink executions) {
+  {
+    TRACE_SPAN(TraceStage::Validate);
+
+    // Order already exists
+    if (orders_.Contains(request.GetOrderId()))
+      return;
+
+    // a book without an expiry index cannot honour an expiry
+    if constexpr (!ExpiryPolicy::TracksExpiry)
+      if (request.HasExpiry())
+        return;
+
+    // limit and stop prices have to be on the instrument's tick
+    if (request.GetOrderType() != OrderType::Market &&
+        !IsOnTick(request.GetPrice(), tickSize_))
+      return;
+    if (request.IsStop() && !IsOnTick(request.GetStopPrice(), tickSize_))
+      return;
+  }
+
+  // stops wait in stops_ until a trade reaches their stop price
+  if (request.IsStop()) {
+    AddStopOrder(request, executions);
+    return;
+  }
+
+  // FAK, FOK and market orders are matched as they come and never rest
+  if (request.GetOrderType() == OrderType::FillAndKill ||
+      request.GetOrderType() == OrderType::FillOrKill ||
+      request.GetOrderType() == OrderType::Market) {
+    // nothing matches during an auction, there is no immediate fill to take
+    if (inAuction_)
+      return;
+
+    AddTransientOrder(request, executions);
+    ReleaseStops(executions);
+    return;
+  }
+
+  // a ladder only spans ladderMaxTicks_ a side, a price further out than
+  // that is refused rather than grown to
+  if (!CanHold(request.GetSide(), request.GetPrice()))
+    return;
+
+  Order *order;
+  {
+    TRACE_SPAN(TraceStage::Insert);
+
+    // the book works on its own pooled copy
+    order = pool_.Acquire(request);
+    if (order->GetPeakQuantity())
+      ++icebergs_;
+
+    // Good For Day lasts until the session closes, unless told otherwise
+    if (order->GetOrderType() == OrderType::GoodForDay &&
+        order->GetExpiry() == Timestamp{})
+      order->SetExpiry(session_.NextClose(
+          std::chrono::time_point_cast<Timestamp::duration>(
+              std::chrono::system_clock::now())));
+
+    // adding the order into a level in bids_ or asks_
+    auto &level = order->GetSide() == Side::Buy ? bids_[order->GetPrice()]
+                                                : asks_[order->GetPrice()];
+    level.orders_.push_back(order);
+
+    // adding the order into orders_
+    orders_.Insert(order->GetOrderId(), order);
+
+    if constexpr (ExpiryPolicy::TracksExpiry) {
+      if (order->HasExpiry()) {
+        // the expiry thread sleeps until the earliest expiry, wake it for one
+        // that comes sooner
+        if constexpr (ExpiryPolicy::RunsThread)
+          if (lock_.IsLocked() && order->GetExpiry() < expiries_.NextExpiry())
+            expiryWorker_.wake_.notify_one();
+        AddExpiry(order);
+      }
+    }
+
+    OnOrderAdded(order, level);
+  }
+
+  if (inAuction_)
+    return;
+
+  MatchOrders(order->GetSide(), executions);
+  ReleaseStops(executions);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::AddTransientOrder(const Order &request,
+                                                 ExecutionSink executions) {
+  // matched from a copy on the stack: whatever does not fill is simply
+  // dropped, the pool, orders_ and the levels never see the order
+  Order order = request;
+  {
+    TRACE_SPAN(TraceStage::Validate);
+
+    // Market order turns into a fill and kill of the worst current price
+    if (order.GetOrderType() == OrderType::Market) {
+      if (order.GetSide() == Side::Buy && !asks_.empty())
+        order.ToFillAndKill(asks_.WorstPrice());
+      else if (order.GetSide() == Side::Sell && !bids_.empty())
+        order.ToFillAndKill(bids_.WorstPrice());
+      else
+        return;
+    }
+
+    // Fill And Kill
+    if (order.GetOrderType() == OrderType::FillAndKill &&
+        !CanMatch(order.GetSide(), order.GetPrice()))
+      return;
+
+    // Fill Or Kill
+    if (order.GetOrderType() == OrderType::FillOrKill &&
+        !CanFullyFill(order.GetSide(), order.GetPrice(),
+                      order.GetInitialQuantity()))
+      return;
+  }
+
+  TRACE_SPAN(TraceStage::MatchLoop);
+  if (order.GetSide() == Side::Buy)
+    MatchTransient(order, asks_, executions);
+  else
+    MatchTransient(order, bids_, executions);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::AddStopOrder(const Order &request,
+                                            ExecutionSink executions) {
+  // a pending stop is pooled and known to orders_, so it can be cancelled, but
+  // sits in no level: it is not part of the depth until it fires
+  Order *order = pool_.Acquire(request);
+  orders_.Insert(order->GetOrderId(), order);
+  stops_.Add(order);
+
+  // the last trade may already be through the stop price
+  ReleaseStops(executions);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::ReleaseStops(ExecutionSink executions) {
+  // adding a fired stop comes back here, the outer call picks up whatever its
+  // trades fire in turn instead of recursing
+  if (releasingStops_ || inAuction_ || stops_.empty() || !lastTradePrice_)
+    return;
+
+  releasingStops_ = true;
+  while (Order *stop = stops_.PopTriggered(*lastTradePrice_)) {
+    const Order triggered = stop->Triggered();
+    orders_.Erase(stop->GetOrderId());
+    pool_.Release(stop);
+    AddOrderInternal(triggered, executions);
+  }
+  releasingStops_ = false;
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::CancelOrders(
+    std::span<const OrderId> orderIds) {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+
+  for (const auto orderId : orderIds)
+    CancelOrderInternal(orderId);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::CancelOrder(OrderId orderId) {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+  CancelOrderInternal(orderId);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::CancelOrderInternal(OrderId orderId) {
+  Order *order = orders_.Erase(orderId);
+  if (!order)
+    return;
+
+  if (order->IsStop())
+    stops_.Remove(order);
+  else
+    RemoveFromLevel(order);
+  RetireExpiry(order);
+  if (order->GetPeakQuantity())
+    --icebergs_;
+  pool_.Release(order);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::RemoveFromLevel(Order *order) {
+  if (order->GetSide() == Side::Buy) {
+    auto price = order->GetPrice();
+    auto &bidLevel = bids_.at(price);
+    bidLevel.orders_.erase(order);
+    OnOrderCancelled(order, bidLevel);
+
+    if (bidLevel.orders_.empty())
+      bids_.erase(price);
+  } else {
+    auto price = order->GetPrice();
+    auto &askLevel = asks_.at(price);
+    askLevel.orders_.erase(order);
+    OnOrderCancelled(order, askLevel);
+
+    if (askLevel.orders_.empty())
+      asks_.erase(price);
+  }
+}
+
+template <typename Policies>
+Trades BasicOrderbook<Policies>::ModifyOrder(const OrderModify &order) {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+
+  Trades trades;
+  ModifyOrderInternal(order, trades);
+  return trades;
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::ModifyOrder(const OrderModify &order,
+                                           ExecutionSink executions) {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+  ModifyOrderInternal(order, executions);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::ModifyOrders(
+    std::span<const OrderModify> orders, ExecutionSink executions) {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+
+  for (const auto &order : orders)
+    ModifyOrderInternal(order, executions);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::ModifyOrderInternal(
+    const OrderModify &order, ExecutionSink executions) {
+  Order *existingOrder = orders_.Find(order.GetOrderId());
+  if (!existingOrder)
+    return;
+
+  if (order.GetQuantity() == 0) {
+    CancelOrderInternal(order.GetOrderId());
+    return;
+  }
+
+  // a pending stop can only be cancelled, its trigger is not a resting price
+  if (existingOrder->IsStop())
+    return;
+
+  // off the tick or out of the ladder's reach the modify is refused and the
+  // order left as it was
+  if (!IsOnTick(order.GetPrice(), tickSize_) ||
+      !CanHold(existingOrder->GetSide(), order.GetPrice()))
+    return;
+
+  // same price and no more quantity: shrink in place, the order keeps its
+  // time priority and cannot newly cross so there is nothing to match. An
+  // iceberg shrinks its reserve first, the level only sees what it shows.
+  if (order.GetPrice() == existingOrder->GetPrice() &&
+      order.GetQuantity() <= existingOrder->GetOpenQuantity()) {
+    const auto reduction =
+        existingOrder->GetOpenQuantity() - order.GetQuantity();
+    if (reduction == 0)
+      return;
+
+    const auto shown = existingOrder->GetRemainingQuantity();
+    existingOrder->ReduceQuantity(reduction);
+    if (shown == existingOrder->GetRemainingQuantity())
+      return;
+
+    auto &level = existingOrder->GetSide() == Side::Buy
+                      ? bids_.at(existingOrder->GetPrice())
+                      : asks_.at(existingOrder->GetPrice());
+    OnOrderReduced(existingOrder, level,
+                   shown - existingOrder->GetRemainingQuantity());
+    return;
+  }
+
+  // a new price or more quantity loses priority: the same pooled order and
+  // orders_ entry are requeued at the back of the new level, then matched
+  RemoveFromLevel(existingOrder);
+  existingOrder->Replace(order.GetPrice(), order.GetQuantity());
+
+  auto &level = existingOrder->GetSide() == Side::Buy
+                    ? bids_[existingOrder->GetPrice()]
+                    : asks_[existingOrder->GetPrice()];
+  level.orders_.push_back(existingOrder);
+  OnOrderAdded(existingOrder, level);
+
+  if (inAuction_)
+    return;
+
+  MatchOrders(existingOrder->GetSide(), executions);
+  ReleaseStops(executions);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::ProcessCommands(
+    std::span<const Command> commands, ExecutionSink executions) {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+
+  for (const auto &command : commands) {
+    switch (command.type_) {
+    case CommandType::Add:
+      if (command.IsWellFormed())
+        AddOrderInternal(command.ToOrder(), executions);
+      break;
+    case CommandType::Cancel:
+      CancelOrderInternal(command.orderId_);
+      break;
+    case CommandType::Modify:
+      ModifyOrderInternal(command.ToOrderModify(), executions);
+      break;
+    case CommandType::PruneGoodForDay:
+      CancelGoodForDayOrdersInternal();
+      break;
+    case CommandType::Expire:
+      CancelExpiredOrdersInternal(command.expiry_, command.quantity_);
+      break;
+    case CommandType::StartAuction:
+      inAuction_ = true;
+      break;
+    case CommandType::Uncross:
+      UncrossInternal(executions);
+      break;
+    }
+  }
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::OnOrderAdded(const Order *order,
+                                            PriceLevel &level) {
+  PublishMarketData(MarketDataEventType::OrderAdd, order,
+                    order->GetRemainingQuantity());
+  UpdateLevelData(order, level, order->GetRemainingQuantity(),
+                  LevelAction::Add);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::OnOrderCancelled(const Order *order,
+                                                PriceLevel &level) {
+  // only what is left of the order was still counted in the level
+  PublishMarketData(MarketDataEventType::OrderCancel, order,
+                    order->GetRemainingQuantity());
+  UpdateLevelData(order, level, order->GetRemainingQuantity(),
+                  LevelAction::Remove);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::OnOrderReduced(const Order *order,
+                                              PriceLevel &level,
+                                              Quantity quantity) {
+  PublishMarketData(MarketDataEventType::OrderCancel, order, quantity);
+  UpdateLevelData(order, level, quantity, LevelAction::Match);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::OnOrderMatched(const Order *order,
+                                              PriceLevel &level,
+                                              Quantity quantity) {
+  PublishMarketData(MarketDataEventType::OrderExecute, order, quantity);
+  UpdateLevelData(order, level, quantity,
+                  order->IsDepleted() ? LevelAction::Remove
+                                      : LevelAction::Match);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::UpdateLevelData(const Order *order,
+                                               PriceLevel &level,
+                                               Quantity quantity,
+                                               LevelAction action) {
+  TRACE_SPAN(TraceStage::LevelBookkeeping);
+
+  const auto side = order->GetSide();
+  auto &sideQuantity = side == Side::Buy ? bidQuantity_ : askQuantity_;
+  const bool isNewLevel = level.quantity_ == 0;
+
+  if (action == LevelAction::Add) {
+    level.quantity_ += quantity;
+    sideQuantity += quantity;
+  } else {
+    level.quantity_ -= quantity;
+    sideQuantity -= quantity;
+  }
+
+  // a level with nothing left is about to be erased by the caller
+  level.sequence_ = ++depthSequence_;
+  if (level.quantity_ == 0)
+    (side == Side::Buy ? bidRemovedSequence_ : askRemovedSequence_) =
+        depthSequence_;
+
+  PublishMarketData(level.quantity_ == 0 ? MarketDataEventType::LevelDelete
+                    : isNewLevel         ? MarketDataEventType::LevelAdd
+                                         : MarketDataEventType::LevelChange,
+                    order, level.quantity_);
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::PublishMarketData(MarketDataEventType type,
+                                                 const Order *order,
+                                                 Quantity quantity) {
+  if (!marketData_)
+    return;
+
+  const bool isLevelEvent = type == MarketDataEventType::LevelAdd ||
+                            type == MarketDataEventType::LevelChange ||
+                            type == MarketDataEventType::LevelDelete;
+
+  const MarketDataEvent event{++marketDataSequence_,
+                              isLevelEvent ? OrderId{} : order->GetOrderId(),
+                              order->GetPrice(),
+                              quantity,
+                              type,
+                              order->GetSide()};
+
+  if (!marketData_->TryPush(event))
+    ++marketDataDropped_;
+}
+
+template <typename Policies>
+bool BasicOrderbook<Policies>::Contains(OrderId orderId) const {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+  return orders_.Contains(orderId);
+}
+
+template <typename Policies>
+std::size_t BasicOrderbook<Policies>::Size() const {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+  return orders_.size();
+}
+
+template <typename Policies>
+std::uint64_t BasicOrderbook<Policies>::DroppedMarketData() const {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+  return marketDataDropped_;
+}
+
+template <typename Policies>
+OrderbookPriceLevelInfos BasicOrderbook<Policies>::GetOrderInfos() const {
+  return GetDepth(std::numeric_limits<std::size_t>::max());
+}
+
+template <typename Policies>
+OrderbookPriceLevelInfos
+BasicOrderbook<Policies>::GetDepth(std::size_t levels) const {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+
+  auto CreateLevelInfos = [levels](const auto &side) {
+    PriceLevelInfos infos;
+    infos.reserve(std::min(levels, side.size()));
+
+    side.ForEach([&](Price price, const PriceLevel &level) {
+      if (infos.size() == levels)
+        return false;
+
+      infos.push_back(PriceLevelInfo{price, level.quantity_});
+      return true;
+    });
+    return infos;
+  };
+
+  return OrderbookPriceLevelInfos{CreateLevelInfos(bids_),
+                                  CreateLevelInfos(asks_)};
+}
+
+template <typename Policies>
+SnapshotOrders BasicOrderbook<Policies>::Snapshot() const {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+
+  SnapshotOrders snapshot;
+  snapshot.reserve(orders_.size());
+
+  auto CopyLevels = [&snapshot](const auto &side) {
+    side.ForEach([&snapshot](Price, const PriceLevel &level) {
+      for (const auto *order : level.orders_)
+        snapshot.push_back(SnapshotOrder::FromOrder(*order));
+    });
+  };
+  CopyLevels(bids_);
+  CopyLevels(asks_);
+  stops_.ForEach([&snapshot](const Order &order) {
+    snapshot.push_back(SnapshotOrder::FromOrder(order));
+  });
+
+  return snapshot;
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::Restore(
+    std::span<const SnapshotOrder> orders) {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+
+  if (!orders_.empty())
+    throw std::logic_error("Snapshot can only be restored into an empty book.");
+  ValidateSnapshot(orders);
+
+  orders_.reserve(orders.size());
+  for (const auto &saved : orders) {
+    const auto orderType = static_cast<OrderType>(saved.orderType_);
+    const auto side = static_cast<Side>(saved.side_);
+
+    // pending stops come last, in the order they fire
+    if (orderType == OrderType::Stop || orderType == OrderType::StopLimit) {
+      Order *stop = pool_.Acquire(
+          orderType == OrderType::Stop
+              ? Order::Stop(saved.orderId_, side, saved.stopPrice_,
+                            saved.initialQuantity_)
+              : Order::StopLimit(saved.orderId_, side, saved.stopPrice_,
+                                 saved.price_, saved.initialQuantity_));
+      orders_.Insert(stop->GetOrderId(), stop);
+      stops_.Add(stop);
+      continue;
+    }
+
+    const Timestamp expiry{std::chrono::nanoseconds{saved.expiry_}};
+    Order *order =
+        saved.peakQuantity_
+            ? pool_.Acquire(Order::Iceberg(orderType, saved.orderId_, side,
+                                           saved.price_, saved.initialQuantity_,
+                                           saved.peakQuantity_, expiry))
+            : pool_.Acquire(orderType, saved.orderId_, side, saved.price_,
+                            saved.initialQuantity_, expiry);
+    order->Restore(saved.remainingQuantity_, saved.hiddenQuantity_);
+    if (order->GetPeakQuantity())
+      ++icebergs_;
+
+    // file order is time priority, so appending rebuilds each queue
+    auto &level = order->GetSide() == Side::Buy ? bids_[order->GetPrice()]
+                                                : asks_[order->GetPrice()];
+    level.orders_.push_back(order);
+    orders_.Insert(order->GetOrderId(), order);
+    if constexpr (ExpiryPolicy::TracksExpiry)
+      if (order->HasExpiry())
+        AddExpiry(order);
+    UpdateLevelData(order, level, order->GetRemainingQuantity(),
+                    LevelAction::Add);
+  }
+
+  // the expiry thread has something to wait for now
+  if constexpr (ExpiryPolicy::RunsThread)
+    if (lock_.IsLocked())
+      expiryWorker_.wake_.notify_one();
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::ValidateSnapshot(
+    std::span<const SnapshotOrder> orders) const {
+  auto Refuse = [](const SnapshotOrder &saved, std::string_view reason) {
+    throw std::logic_error(std::format(
+        "Order ({}) cannot be restored, {}.", saved.orderId_, reason));
+  };
+
+  std::vector<OrderId> orderIds;
+  orderIds.reserve(orders.size());
+  // lowest and highest resting price seen so far on each side
+  constexpr std::pair<std::int64_t, std::int64_t> NoPrices{
+      std::numeric_limits<std::int64_t>::max(),
+      std::numeric_limits<std::int64_t>::min()};
+  auto bidPrices = NoPrices;
+  auto askPrices = NoPrices;
+
+  for (const auto &saved : orders) {
+    const auto orderType = static_cast<OrderType>(saved.orderType_);
+    if (saved.orderType_ > static_cast<std::uint8_t>(OrderType::StopLimit))
+      Refuse(saved, "its order type is unknown");
+    if (saved.side_ > static_cast<std::uint8_t>(Side::Sell))
+      Refuse(saved, "its side is unknown");
+    orderIds.push_back(saved.orderId_);
+
+    if (orderType == OrderType::Stop || orderType == OrderType::StopLimit) {
+      if (!IsOnTick(saved.stopPrice_, tickSize_) ||
+          (orderType == OrderType::StopLimit &&
+           !IsOnTick(saved.price_, tickSize_)))
+        Refuse(saved, "its prices are off the tick");
+      continue;
+    }
+
+    // only orders that rest are saved on levels, and they rest as Restore
+    // rebuilds them: on the tick, showing something, within the ladder
+    if (!Order::CanBeIceberg(orderType))
+      Refuse(saved, "only resting orders sit on a level");
+    if (!ExpiryPolicy::TracksExpiry && (orderType == OrderType::GoodForDay ||
+                                        orderType == OrderType::GoodTillDate))
+      Refuse(saved, "a book without expiry cannot hold an expiring order");
+    if (!IsOnTick(saved.price_, tickSize_))
+      Refuse(saved, "its price is off the tick");
+    if (saved.remainingQuantity_ == 0 ||
+        std::uint64_t{saved.remainingQuantity_} + saved.hiddenQuantity_ >
+            saved.initialQuantity_)
+      Refuse(saved, "its quantities do not add up");
+    if (saved.hiddenQuantity_ != 0 && saved.peakQuantity_ == 0)
+      Refuse(saved, "only an iceberg holds a reserve");
+
+    const bool buy = static_cast<Side>(saved.side_) == Side::Buy;
+    auto &[low, high] = buy ? bidPrices : askPrices;
+    low = std::min<std::int64_t>(low, saved.price_);
+    high = std::max<std::int64_t>(high, saved.price_);
+    if (!(buy ? bids_.CanSpan(low, high) : asks_.CanSpan(low, high)))
+      Refuse(saved, "it rests beyond the ladder's reach");
+  }
+
+  // only a book in a call auction rests crossed, a continuous one would match
+  // the restored orders against each other on the next trade
+  if (!inAuction_ && bidPrices.second >= askPrices.first)
+    throw std::logic_error(std::format(
+        "Snapshot cannot be restored, a bid at {} crosses an ask at {}.",
+        bidPrices.second, askPrices.first));
+
+  std::ranges::sort(orderIds);
+  if (const auto duplicate = std::ranges::adjacent_find(orderIds);
+      duplicate != orderIds.end())
+    throw std::logic_error(std::format(
+        "Order ({}) cannot be restored, its id appears twice.", *duplicate));
+}
+
+template <typename Policies>
+DepthUpdate
+BasicOrderbook<Policies>::GetDepthUpdate(std::size_t levels,
+                                         std::uint64_t sequence) const {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+
+  auto CreateLevelInfos = [levels, sequence](const auto &side, bool replaced) {
+    PriceLevelInfos infos;
+    std::size_t visited{};
+
+    side.ForEach([&](Price price, const PriceLevel &level) {
+      if (visited++ == levels)
+        return false;
+
+      if (replaced || level.sequence_ > sequence)
+        infos.push_back(PriceLevelInfo{price, level.quantity_});
+      return true;
+    });
+    return infos;
+  };
+
+  DepthUpdate update;
+  update.sequence_ = depthSequence_;
+  update.bidsReplaced_ = bidRemovedSequence_ > sequence;
+  update.asksReplaced_ = askRemovedSequence_ > sequence;
+  update.bids_ = CreateLevelInfos(bids_, update.bidsReplaced_);
+  update.asks_ = CreateLevelInfos(asks_, update.asksReplaced_);
+  return update;
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::StartAuction() {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+  inAuction_ = true;
+}
+
+template <typename Policies>
+bool BasicOrderbook<Policies>::InAuction() const {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+  return inAuction_;
+}
+
+template <typename Policies>
+Trades BasicOrderbook<Policies>::Uncross() {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+
+  Trades trades;
+  UncrossInternal(trades);
+  return trades;
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::Uncross(ExecutionSink executions) {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+  UncrossInternal(executions);
+}
+
+template <typename Policies>
+AuctionIndication BasicOrderbook<Policies>::PublishIndicativeUncross() {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+
+  const auto indication = ComputeUncross();
+  if (marketData_) {
+    const MarketDataEvent event{
+        ++marketDataSequence_,
+        OrderId{},
+        indication.price_,
+        static_cast<Quantity>(std::min<std::uint64_t>(
+            indication.volume_, std::numeric_limits<Quantity>::max())),
+        MarketDataEventType::AuctionIndication,
+        indication.ImbalanceSide()};
+    if (!marketData_->TryPush(event))
+      ++marketDataDropped_;
+  }
+  return indication;
+}
+
+template <typename Policies>
+AuctionIndication BasicOrderbook<Policies>::ComputeUncross() const {
+  AuctionIndication best;
+  if (bids_.empty() || asks_.empty() || bids_.BestPrice() < asks_.BestPrice())
+    return best;
+
+  // only levels between the best ask and the best bid can trade, both sides'
+  // are collected in ascending price. The level totals only count what is
+  // displayed and the uncross refills icebergs from their reserve as it goes,
+  // so while icebergs rest the open quantity of each crossing order is summed
+  // instead.
+  const Price low = asks_.BestPrice();
+  const Price high = bids_.BestPrice();
+  std::uint64_t bidVolume{}; // bids at or above the price being looked at
+  std::uint64_t askVolume{}; // asks at or below it
+
+  auto OpenQuantity = [this](const PriceLevel &level) {
+    if (icebergs_ == 0)
+      return level.quantity_;
+
+    Quantity quantity{};
+    for (const auto *order : level.orders_)
+      quantity += order->GetOpenQuantity();
+    return quantity;
+  };
+
+  PriceLevelInfos bids;
+  bids_.ForEach([&](Price price, const PriceLevel &level) {
+    if (price < low)
+      return false;
+
+    bids.push_back(PriceLevelInfo{price, OpenQuantity(level)});
+    bidVolume += bids.back().quantity_;
+    return true;
+  });
+  std::reverse(bids.begin(), bids.end());
+
+  PriceLevelInfos asks;
+  asks_.ForEach([&](Price price, const PriceLevel &level) {
+    if (price > high)
+      return false;
+
+    asks.push_back(PriceLevelInfo{price, OpenQuantity(level)});
+    return true;
+  });
+
+  // one merged walk up through every level price: the ask volume only grows
+  // and the bid volume only shrinks. Most volume wins, then the smallest
+  // surplus, then the lowest price.
+  auto bid = bids.begin();
+  auto ask = asks.begin();
+  while (bid != bids.end() || ask != asks.end()) {
+    const Price price = bid == bids.end()   ? ask->price_
+                        : ask == asks.end() ? bid->price_
+                                            : std::min(bid->price_, ask->price_);
+    if (ask != asks.end() && ask->price_ == price)
+      askVolume += (ask++)->quantity_;
+
+    const auto volume = std::min(bidVolume, askVolume);
+    const auto surplus = std::max(bidVolume, askVolume) - volume;
+    if (volume > best.volume_ ||
+        (volume == best.volume_ &&
+         surplus < best.buySurplus_ + best.sellSurplus_))
+      best = AuctionIndication{price, volume, bidVolume - volume,
+                               askVolume - volume};
+
+    // bids at this price are not willing to pay any higher one
+    if (bid != bids.end() && bid->price_ == price)
+      bidVolume -= (bid++)->quantity_;
+  }
+  return best;
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::UncrossInternal(ExecutionSink executions) {
+  const auto indication = ComputeUncross();
+  inAuction_ = false;
+  if (indication.volume_ == 0)
+    return;
+
+  // price then time priority on both sides as in continuous matching, but
+  // every fill is at the one uncross price. The indication counted reserve
+  // too, so the fills add up to its volume, and at the most volume price
+  // nothing is left crossed once either side runs out of orders through it.
+  const Price price = indication.price_;
+  const Side aggressor = indication.ImbalanceSide();
+  {
+    TRACE_SPAN(TraceStage::MatchLoop);
+
+    while (!bids_.empty() && !asks_.empty() && bids_.BestPrice() >= price &&
+           asks_.BestPrice() <= price) {
+      const Price bestBid = bids_.BestPrice();
+      const Price bestAsk = asks_.BestPrice();
+      auto &levelBids = bids_.Best();
+      auto &levelAsks = asks_.Best();
+
+      while (levelBids.orders_.size() && levelAsks.orders_.size()) {
+        Order *bid = levelBids.orders_.front();
+        Order *ask = levelAsks.orders_.front();
+
+        const Quantity quantity =
+            std::min(bid->GetRemainingQuantity(), ask->GetRemainingQuantity());
+        bid->Fill(quantity);
+        ask->Fill(quantity);
+        executions(Execution{bid->GetOrderId(), ask->GetOrderId(), price,
+                             quantity, aggressor, bid->GetOpenQuantity(),
+                             ask->GetOpenQuantity()});
+
+        OnOrderMatched(bid, levelBids, quantity);
+        OnOrderMatched(ask, levelAsks, quantity);
+        if (bid->IsDepleted())
+          RetireFront(levelBids);
+        if (ask->IsDepleted())
+          RetireFront(levelAsks);
+      }
+
+      if (levelBids.orders_.empty())
+        bids_.erase(bestBid);
+      if (levelAsks.orders_.empty())
+        asks_.erase(bestAsk);
+    }
+  }
+
+  lastTradePrice_ = price;
+  ReleaseStops(executions);
+}
+
+template <typename Policies>
+bool BasicOrderbook<Policies>::CanMatch(Side side, Price price) const {
+  if (side == Side::Buy) {
+    if (asks_.empty())
+      return false;
+
+    return price >= asks_.BestPrice();
+  } else {
+    if (bids_.empty())
+      return false;
+
+    return price <= bids_.BestPrice();
+  }
+}
+
+template <typename Policies>
+bool BasicOrderbook<Policies>::CanFullyFill(Side side, Price price,
+                                            Quantity quantity) const {
+  if (!CanMatch(side, price))
+    return false;
+
+  // walks the opposite side from the touch in price order, stopping at the
+  // first level that completes the fill or no longer crosses the limit
+  auto CanFill = [price, quantity](const auto &levels,
+                                   std::uint64_t sideQuantity,
+                                   auto isCrossing) mutable {
+    if (sideQuantity < quantity)
+      return false;
+
+    bool filled = false;
+    levels.ForEach([&](Price levelPrice, const PriceLevel &level) {
+      if (!isCrossing(levelPrice, price))
+        return false;
+
+      if (quantity <= level.quantity_) {
+        filled = true;
+        return false;
+      }
+
+      quantity -= level.quantity_;
+      return true;
+    });
+
+    return filled;
+  };
+
+  if (side == Side::Buy)
+    return CanFill(asks_, askQuantity_, std::less_equal<Price>{});
+  else
+    return CanFill(bids_, bidQuantity_, std::greater_equal<Price>{});
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::MatchOrders(Side aggressor,
+                                           ExecutionSink executions) {
+  {
+    TRACE_SPAN(TraceStage::MatchLoop);
+
+    while (true) {
+      if (bids_.empty() || asks_.empty())
+        break; // one side is empty, cannot match
+
+      const Price bestBid = bids_.BestPrice();
+      const Price bestAsk = asks_.BestPrice();
+      auto &levelBids = bids_.Best();
+      auto &levelAsks = asks_.Best();
+
+      if (bestBid < bestAsk)
+        break; // best bid cannot match best ask
+
+      // an incoming order that covers the whole opposite level takes it in
+      // one go, with the level bookkeeping done once rather than per fill
+      auto &incomingLevel = aggressor == Side::Buy ? levelBids : levelAsks;
+      auto &restingLevel = aggressor == Side::Buy ? levelAsks : levelBids;
+      Order *incoming = incomingLevel.orders_.front();
+      if (incoming->GetRemainingQuantity() >= restingLevel.quantity_) {
+        OnOrderMatched(incoming, incomingLevel,
+                       SweepLevel(*incoming, restingLevel, executions));
+        if (incoming->IsDepleted())
+          RetireFront(incomingLevel);
+      }
+
+      while (levelBids.orders_.size() && levelAsks.orders_.size()) {
+        Order *bid = levelBids.orders_.front();
+        Order *ask = levelAsks.orders_.front();
+
+        Quantity tradeQuantity =
+            std::min(bid->GetRemainingQuantity(), ask->GetRemainingQuantity());
+
+        bid->Fill(tradeQuantity);
+        ask->Fill(tradeQuantity);
+        lastTradePrice_ = ask->GetPrice();
+
+        executions(Execution{bid->GetOrderId(), ask->GetOrderId(),
+                             ask->GetPrice(), // trade done at ask price
+                             tradeQuantity, aggressor,
+                             bid->GetOpenQuantity(),
+                             ask->GetOpenQuantity()});
+
+        OnOrderMatched(bid, levelBids, tradeQuantity);
+        OnOrderMatched(ask, levelAsks, tradeQuantity);
+
+        // one bid in the current level is filled, or shows its next peak
+        if (bid->IsDepleted())
+          RetireFront(levelBids);
+
+        if (ask->IsDepleted())
+          RetireFront(levelAsks);
+      }
+
+      if (levelBids.orders_.empty()) {
+        bids_.erase(bestBid); // entire level of bestBid is filled
+      }
+
+      if (levelAsks.orders_.empty()) {
+        asks_.erase(bestAsk); // entire level of bestAsk is filled
+      }
+    }
+  }
+}
+
+template <typename Policies>
+template <typename Levels>
+void BasicOrderbook<Policies>::MatchTransient(Order &incoming,
+                                              Levels &levels,
+                                              ExecutionSink executions) {
+  const bool isBuy = incoming.GetSide() == Side::Buy;
+
+  while (!incoming.IsFilled() && !levels.empty()) {
+    const Price price = levels.BestPrice();
+    if (isBuy ? price > incoming.GetPrice() : price < incoming.GetPrice())
+      break; // the rest of the side is beyond the limit
+
+    auto &level = levels.Best();
+    if (incoming.GetRemainingQuantity() >= level.quantity_) {
+      SweepLevel(incoming, level, executions);
+      if (level.orders_.empty())
+        levels.erase(price);
+      continue;
+    }
+
+    // the level covers what is left, taken from the front of its queue
+    while (!incoming.IsFilled()) {
+      Order *resting = level.orders_.front();
+      const Quantity quantity = std::min(incoming.GetRemainingQuantity(),
+                                         resting->GetRemainingQuantity());
+      Execute(incoming, *resting, quantity, executions);
+      OnOrderMatched(resting, level, quantity);
+
+      if (resting->IsDepleted())
+        RetireFront(level);
+    }
+  }
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::Execute(Order &incoming, Order &resting,
+                                       Quantity quantity,
+                                       ExecutionSink executions) {
+  incoming.Fill(quantity);
+  resting.Fill(quantity);
+
+  const bool incomingIsBid = incoming.GetSide() == Side::Buy;
+  const Order &bid = incomingIsBid ? incoming : resting;
+  const Order &ask = incomingIsBid ? resting : incoming;
+  lastTradePrice_ = ask.GetPrice(); // trade done at ask price
+  executions(Execution{bid.GetOrderId(), ask.GetOrderId(), ask.GetPrice(),
+                       quantity, incoming.GetSide(), bid.GetOpenQuantity(),
+                       ask.GetOpenQuantity()});
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::RetireFront(PriceLevel &level) {
+  Order *order = level.orders_.front();
+  level.orders_.pop_front();
+
+  // the next peak is shown as a new order would be, at the back of the level
+  // with a fresh time priority, without leaving orders_ or the pool
+  if (order->HasReserve()) {
+    order->Replenish();
+    level.orders_.push_back(order);
+    OnOrderAdded(order, level);
+    return;
+  }
+
+  orders_.Erase(order->GetOrderId());
+  RetireExpiry(order);
+  if (order->GetPeakQuantity())
+    --icebergs_;
+  pool_.Release(order);
+}
+
+template <typename Policies>
+Quantity BasicOrderbook<Policies>::SweepLevel(Order &incoming,
+                                              PriceLevel &level,
+                                              ExecutionSink executions) {
+  const Quantity swept = level.quantity_;
+
+  // takes what the level shows when the sweep starts, icebergs replenished on
+  // the way queue up behind and are left in the level for the caller
+  for (auto count = level.orders_.size(); count != 0; --count) {
+    Order *resting = level.orders_.front();
+    const Quantity quantity = resting->GetRemainingQuantity();
+    Execute(incoming, *resting, quantity, executions);
+    PublishMarketData(MarketDataEventType::OrderExecute, resting, quantity);
+
+    // the last order stands in for the quantity the sweep took off the level
+    if (count == 1)
+      UpdateLevelData(resting, level, swept, LevelAction::Remove);
+    RetireFront(level);
+  }
+  return swept;
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::PruneExpiredOrders() {
+  if constexpr (ExpiryPolicy::RunsThread) {
+    std::unique_lock ordersLock{lock_.Mutex()};
+
+    while (true) {
+      // sleeps until the earliest expiry, an add with an earlier one wakes it
+      const auto next = expiries_.NextExpiry();
+      auto Woken = [this, next]() {
+        // can see your writes
+        return expiryWorker_.shutdown_.load(std::memory_order_acquire) ||
+               expiries_.NextExpiry() < next;
+      };
+      if (next == Timestamp::max())
+        expiryWorker_.wake_.wait(ordersLock, Woken);
+      else
+        expiryWorker_.wake_.wait_until(ordersLock, next, Woken);
+
+      if (expiryWorker_.shutdown_.load(std::memory_order_acquire))
+        return;
+
+      // bounded batches, the lock is let go in between so matching carries on
+      // while a large expiry (the close) is worked through
+      const auto now = std::chrono::time_point_cast<Timestamp::duration>(
+          std::chrono::system_clock::now());
+      while (CancelExpiredOrdersInternal(now, expiryBatch_) == expiryBatch_) {
+        ordersLock.unlock();
+        std::this_thread::yield();
+        ordersLock.lock();
+      }
+    }
+  }
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::CancelGoodForDayOrders() {
+  // create lock outside of for loop for performance reasons
+  [[maybe_unused]] auto ordersLock = LockOrders();
+  CancelGoodForDayOrdersInternal();
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::CancelGoodForDayOrdersInternal() {
+  // only orders that expire are looked at, not the whole book, and a book
+  // without an expiry index has none
+  if constexpr (ExpiryPolicy::TracksExpiry) {
+    OrderIds orderIds;
+    expiries_.ForEach([this, &orderIds](OrderId orderId, Timestamp expiry) {
+      const auto *order = orders_.Find(orderId);
+      if (order && order->GetOrderType() == OrderType::GoodForDay &&
+          order->GetExpiry() == expiry)
+        orderIds.push_back(orderId);
+    });
+
+    for (const auto orderId : orderIds)
+      CancelOrderInternal(orderId);
+
+    // the walk has been paid for already, take the stale ids out with it
+    expiries_.Compact([this](OrderId orderId, Timestamp expiry) {
+      return HoldsExpiry(orderId, expiry);
+    });
+  }
+}
+
+template <typename Policies>
+bool BasicOrderbook<Policies>::HoldsExpiry(OrderId orderId,
+                                           Timestamp expiry) const {
+  // the order may have filled or been cancelled since, or its id been reused
+  // by an order with another expiry
+  const auto *order = orders_.Find(orderId);
+  return order && order->HasExpiry() && order->GetExpiry() == expiry;
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::AddExpiry([[maybe_unused]] const Order *order) {
+  // cancels and fills leave their ids behind, drop them before they pile up
+  if constexpr (ExpiryPolicy::TracksExpiry) {
+    if (expiries_.IsMostlyStale())
+      expiries_.Compact([this](OrderId orderId, Timestamp expiry) {
+        return HoldsExpiry(orderId, expiry);
+      });
+    expiries_.Add(order->GetExpiry(), order->GetOrderId());
+  }
+}
+
+template <typename Policies>
+void BasicOrderbook<Policies>::RetireExpiry(
+    [[maybe_unused]] const Order *order) {
+  if constexpr (ExpiryPolicy::TracksExpiry)
+    if (order->HasExpiry())
+      expiries_.Retire();
+}
+
+template <typename Policies>
+std::size_t
+BasicOrderbook<Policies>::CancelExpiredOrders(Timestamp now,
+                                              std::size_t maxOrders) {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+  return CancelExpiredOrdersInternal(now, maxOrders);
+}
+
+template <typename Policies>
+std::size_t BasicOrderbook<Policies>::CancelExpiredOrdersInternal(
+    [[maybe_unused]] Timestamp now, [[maybe_unused]] std::size_t maxOrders) {
+  if constexpr (!ExpiryPolicy::TracksExpiry)
+    return 0;
+  else
+    return expiries_.PopDue(
+        now, maxOrders, [this](OrderId orderId, Timestamp expiry) {
+          if (HoldsExpiry(orderId, expiry))
+            CancelOrderInternal(orderId);
+        });
+}
+
+template <typename Policies>
+Timestamp BasicOrderbook<Policies>::NextExpiry() const {
+  [[maybe_unused]] auto ordersLock = LockOrders();
+  if constexpr (ExpiryPolicy::TracksExpiry)
+    return expiries_.NextExpiry();
+  else
+    return Timestamp::max();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+
+#include "Order.h"
+
+// intrusive FIFO of the orders resting at one price level, the links live
+// inside Order itself so queueing and unqueueing never allocate
+class OrderList {
+public:
+  class Iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Order *;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Order *const *;
+    using reference = Order *const &;
+
+    Iterator() = default;
+    explicit Iterator(Order *order) : order_{order} {}
+
+    reference operator*() const { return order_; }
+    Iterator &operator++() {
+      order_ = order_->next_;
+      return *this;
+    }
+    Iterator operator++(int) {
+      auto copy = *this;
+      ++*this;
+      return copy;
+    }
+    bool operator==(const Iterator &) const = default;
+
+  private:
+    Order *order_{nullptr};
+  };
+
+  OrderList() = default;
+  OrderList(const OrderList &) = delete;
+  OrderList &operator=(const OrderList &) = delete;
+  OrderList(OrderList &&other) noexcept
+      : head_{other.head_}, tail_{other.tail_}, size_{other.size_} {
+    other.head_ = other.tail_ = nullptr;
+    other.size_ = 0;
+  }
+  OrderList &operator=(OrderList &&other) noexcept {
+    head_ = std::exchange(other.head_, nullptr);
+    tail_ = std::exchange(other.tail_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    return *this;
+  }
+
+  bool empty() const { return size_ == 0; }
+  std::size_t size() const { return size_; }
+  Order *front() const { return head_; }
+  Order *back() const { return tail_; }
+  Iterator begin() const { return Iterator{head_}; }
+  Iterator end() const { return Iterator{}; }
+
+  void push_back(Order *order) {
+    order->prev_ = tail_;
+    order->next_ = nullptr;
+    if (tail_)
+      tail_->next_ = order;
+    else
+      head_ = order;
+    tail_ = order;
+    ++size_;
+  }
+
+  void pop_front() { erase(head_); }
+
+  void erase(Order *order) {
+    if (order->prev_)
+      order->prev_->next_ = order->next_;
+    else
+      head_ = order->next_;
+
+    if (order->next_)
+      order->next_->prev_ = order->prev_;
+    else
+      tail_ = order->prev_;
+
+    order->prev_ = order->next_ = nullptr;
+    --size_;
+  }
+
+private:
+  Order *head_{nullptr};
+  Order *tail_{nullptr};
+  std::uint32_t size_{};
+};
@@ -10,9 +10,8 @@ public:
   OrderId GetOrderId() const { return orderId_; }
   Price GetPrice() const { return price_; }
   Quantity GetQuantity() const { return quantity_; }
-  OrderPointer ToOrderPointer(OrderType type, Side side) const {
-    return std::make_shared<Order>(type, GetOrderId(), side, GetPrice(),
-                                   GetQuantity());
+  Order ToOrder(OrderType type, Side side) const {
+    return Order{type, GetOrderId(), side, GetPrice(), GetQuantity()};
   }
 
 private:
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "Constants.h"
+#include "Order.h"
+
+// slab allocator for resting orders. Slots are handed out from a free list and
+// returned to it on release, so once the book has warmed up to its working set
+// adding, cancelling and matching orders never touches the heap. When every
+// slot is in use another slab as large as all the others is appended, so a pool
+// started small reaches a big book in a few allocations.
+class OrderPool {
+public:
+  explicit OrderPool(std::size_t capacity) {
+    Grow(capacity ? capacity : 1);
+  }
+
+  OrderPool(const OrderPool &) = delete;
+  OrderPool &operator=(const OrderPool &) = delete;
+
+  template <typename... Args> Order *Acquire(Args &&...args) {
+    if (!free_)
+      Grow(capacity_);
+
+    Slot *slot = free_;
+    free_ = slot->next_;
+    ++inUse_;
+    return ::new (slot->storage_) Order(std::forward<Args>(args)...);
+  }
+
+  void Release(Order *order) {
+    order->~Order();
+    auto *slot = reinterpret_cast<Slot *>(order);
+    slot->next_ = free_;
+    free_ = slot;
+    --inUse_;
+  }
+
+  std::size_t Capacity() const { return capacity_; }
+  std::size_t InUse() const { return inUse_; }
+
+private:
+  // a slot per cache line, so a fill never touches more than one line of an
+  // order (unaligned, most orders would straddle two)
+  union alignas(Constants::CACHE_LINE_SIZE) Slot {
+    Slot *next_;
+    alignas(Order) std::byte storage_[sizeof(Order)];
+  };
+  static_assert(sizeof(Order) <= Constants::CACHE_LINE_SIZE);
+
+  void Grow(std::size_t size) {
+    auto slab = std::make_unique<Slot[]>(size);
+    for (std::size_t i = size; i-- > 0;) {
+      slab[i].next_ = free_;
+      free_ = &slab[i];
+    }
+    slabs_.push_back(std::move(slab));
+    capacity_ += size;
+  }
+
+  std::size_t capacity_{};
+  std::vector<std::unique_ptr<Slot[]>> slabs_;
+  Slot *free_{nullptr};
+  std::size_t inUse_{};
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "Order.h"
+#include "Usings.h"
+
+// order id -> pooled order, as a flat open addressing table with linear
+// probing. A slot keeps the id next to the pointer, so a lookup is one hash and
+// usually one cache line, and Erase finds and removes in the same probe. Erase
+// shifts the rest of the run back instead of leaving tombstones, so probes do
+// not get longer over a session of cancels. Sized at twice the expected order
+// count, doubling whenever it gets past half full.
+class OrderTable {
+public:
+  OrderTable(std::pmr::memory_resource *resource, std::size_t capacity)
+      : slots_{resource} {
+    Rehash(SlotsFor(capacity));
+  }
+
+  bool empty() const { return size_ == 0; }
+  std::size_t size() const { return size_; }
+
+  void reserve(std::size_t count) {
+    if (2 * count > slots_.size())
+      Rehash(SlotsFor(count));
+  }
+
+  bool Contains(OrderId orderId) const { return Find(orderId) != nullptr; }
+
+  // nullptr if the id is not in the table
+  Order *Find(OrderId orderId) const {
+    for (auto index = Home(orderId);; index = Next(index)) {
+      const auto &slot = slots_[index];
+      if (!slot.order_ || slot.orderId_ == orderId)
+        return slot.order_;
+    }
+  }
+
+  // false, storing nothing, if the id is already in the table
+  bool Insert(OrderId orderId, Order *order) {
+    if (2 * (size_ + 1) > slots_.size())
+      Rehash(2 * slots_.size());
+
+    auto index = Home(orderId);
+    for (; slots_[index].order_; index = Next(index))
+      if (slots_[index].orderId_ == orderId)
+        return false;
+
+    slots_[index] = Slot{orderId, order};
+    ++size_;
+    return true;
+  }
+
+  // takes the id out and hands back its order, nullptr if it was not there
+  Order *Erase(OrderId orderId) {
+    for (auto index = Home(orderId); slots_[index].order_;
+         index = Next(index)) {
+      if (slots_[index].orderId_ != orderId)
+        continue;
+
+      Order *order = slots_[index].order_;
+      ShiftBack(index);
+      --size_;
+      return order;
+    }
+    return nullptr;
+  }
+
+private:
+  struct Slot {
+    OrderId orderId_{};
+    Order *order_{nullptr}; // nullptr marks an empty slot
+  };
+
+  static constexpr std::size_t MinSlots = 16;
+
+  static std::size_t SlotsFor(std::size_t count) {
+    return std::bit_ceil(std::max(2 * count, MinSlots));
+  }
+
+  // fibonacci hashing: the top bits of id * 2^64/phi spread both dense
+  // session sequences and sparse client ids over the table
+  std::size_t Home(OrderId orderId) const {
+    return static_cast<std::size_t>(
+        (static_cast<std::uint64_t>(orderId) * 0x9E3779B97F4A7C15ull) >>
+        shift_);
+  }
+  std::size_t Next(std::size_t index) const { return (index + 1) & mask_; }
+
+  // closes the hole left at index by pulling back each later entry of the run
+  // whose home is at or before the hole, so every entry stays reachable
+  void ShiftBack(std::size_t hole) {
+    for (auto index = Next(hole); slots_[index].order_; index = Next(index)) {
+      const auto home = Home(slots_[index].orderId_);
+      if (((index - home) & mask_) >= ((index - hole) & mask_)) {
+        slots_[hole] = slots_[index];
+        hole = index;
+      }
+    }
+    slots_[hole] = Slot{};
+  }
+
+  void Rehash(std::size_t count) {
+    std::pmr::vector<Slot> slots(count, slots_.get_allocator());
+    std::swap(slots_, slots);
+    mask_ = count - 1;
+    shift_ = 64 - std::countr_zero(count);
+
+    size_ = 0;
+    for (const auto &slot : slots)
+      if (slot.order_)
+        Insert(slot.orderId_, slot.order_);
+  }
+
+  std::pmr::vector<Slot> slots_;
+  std::size_t size_{};
+  std::size_t mask_{};
+  int shift_{};
+};
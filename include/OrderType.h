@@ -1,9 +1,14 @@
 #pragma once
 
-enum class OrderType {
+#include <cstdint>
+
+enum class OrderType : std::uint8_t {
   GoodTillCancel,
   FillAndKill,
   FillOrKill,
   GoodForDay,
-  Market
+  GoodTillDate,
+  Market,
+  Stop,
+  StopLimit
 };
\ No newline at end of file
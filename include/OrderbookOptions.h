@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+
+#include "Constants.h"
+#include "MarketDataEvent.h"
+#include "SpscRing.h"
+#include "TradingSession.h"
+#include "Usings.h"
+
+enum class Threading {
+  // every call takes the book mutex, a background thread expires GFD and GTD
+  // orders as they come due
+  Locked,
+  // one thread owns the book and is the only caller: no mutex is taken and no
+  // expiry thread is started, the owner calls CancelExpiredOrders
+  SingleWriter,
+};
+
+struct OrderbookOptions {
+  Threading threading_{Threading::Locked};
+
+  // slots preallocated in the order pool (more slabs are added when exceeded)
+  // and what the order id table is first sized for
+  std::size_t orderCapacity_{Constants::DEFAULT_ORDER_CAPACITY};
+
+  // ladder backend only: price the ladder starts centred on (defaults to the
+  // first price added) and how many ticks it spans before it has to grow
+  std::optional<Price> ladderCenter_{};
+  std::size_t ladderTicks_{Constants::DEFAULT_LADDER_TICKS};
+  // ladder backend only: the most ticks one side may span between its lowest
+  // and highest resting price. An order that would rest further out is
+  // refused, so a stray price cannot grow the array without bound (32 bytes
+  // a tick, 8 MB a side by default).
+  std::size_t ladderMaxTicks_{Constants::DEFAULT_LADDER_MAX_TICKS};
+
+  // preallocated ring the book publishes L2/L3 events into, drained by a
+  // publisher thread without touching the book lock. Events that find the
+  // ring full are dropped and counted, leaving a gap in the sequence.
+  SpscRing<MarketDataEvent> *marketData_{nullptr};
+
+  // price units per tick for this instrument, limit prices and modifies off
+  // the tick are refused (see TickSize.h)
+  Price tickSize_{1};
+
+  // sets when GFD orders expire
+  TradingSession session_{};
+  // most orders one expiry batch cancels before the lock is let go
+  std::size_t expiryBatch_{Constants::DEFAULT_EXPIRY_BATCH};
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <mutex>
+#include <type_traits>
+
+#include "OrderbookOptions.h"
+
+// what a book is built from, fixed at compile time so a deployment only pays
+// for the machinery it uses:
+// - LevelPolicy stores the price levels (TreeLevels, LadderLevels)
+// - LockPolicy serialises the public calls (OptionsLock, MutexLock, NoLock)
+// - ExpiryPolicy cancels GFD and GTD orders as they come due (ExpiryThread,
+//   ExternalExpiry, NoExpiry)
+// The defaults are what Orderbook has always been. Order types are not a
+// policy, every book takes them all and branches on them per order.
+
+// lock policies: Lock() hands back a guard held for the length of a call
+
+// locked unless OrderbookOptions::threading_ says SingleWriter, decided when
+// the book is built
+class OptionsLock {
+public:
+  explicit OptionsLock(const OrderbookOptions &options)
+      : singleWriter_{options.threading_ == Threading::SingleWriter} {}
+
+  std::unique_lock<std::mutex> Lock() const {
+    if (singleWriter_)
+      return std::unique_lock{mutex_, std::defer_lock};
+    return std::unique_lock{mutex_};
+  }
+  bool IsLocked() const { return !singleWriter_; }
+  std::mutex &Mutex() const { return mutex_; }
+
+private:
+  mutable std::mutex mutex_;
+  const bool singleWriter_;
+};
+
+// always locked, whatever the options say
+class MutexLock {
+public:
+  explicit MutexLock(const OrderbookOptions &) {}
+
+  std::unique_lock<std::mutex> Lock() const { return std::unique_lock{mutex_}; }
+  bool IsLocked() const { return true; }
+  std::mutex &Mutex() const { return mutex_; }
+
+private:
+  mutable std::mutex mutex_;
+};
+
+// one thread owns the book and is its only caller: there is no mutex, the
+// guard is an empty object and every call inlines down to the work itself
+class NoLock {
+public:
+  struct Guard {};
+
+  explicit NoLock(const OrderbookOptions &) {}
+
+  Guard Lock() const { return {}; }
+  static constexpr bool IsLocked() { return false; }
+};
+
+// expiry policies
+
+// a background thread sleeps until the next expiry and cancels what is due in
+// bounded batches under the book's mutex. Only started if the book is locked,
+// a single writer book behaves as ExternalExpiry.
+struct ExpiryThread {
+  static constexpr bool TracksExpiry = true;
+  static constexpr bool RunsThread = true;
+};
+
+// the expiry index is kept but nothing runs in the background, the owner
+// calls CancelExpiredOrders or sends Expire commands (as MatchingCore does)
+struct ExternalExpiry {
+  static constexpr bool TracksExpiry = true;
+  static constexpr bool RunsThread = false;
+};
+
+// no expiry index at all, GFD and GTD orders are refused
+struct NoExpiry {
+  static constexpr bool TracksExpiry = false;
+  static constexpr bool RunsThread = false;
+};
+
+template <typename Levels, typename Lock = OptionsLock,
+          typename Expiry = ExpiryThread>
+struct OrderbookPolicies {
+  using LevelPolicy = Levels;
+  using LockPolicy = Lock;
+  using ExpiryPolicy = Expiry;
+
+  static_assert(!Expiry::RunsThread || !std::is_same_v<Lock, NoLock>,
+                "an expiry thread needs a book with a mutex to share");
+};
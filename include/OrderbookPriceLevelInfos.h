@@ -1,12 +1,13 @@
 #pragma once
 
+#include <utility>
+
 #include "PriceLevelInfo.h"
 
 class OrderbookPriceLevelInfos {
 public:
-  OrderbookPriceLevelInfos(const PriceLevelInfos &bids,
-                           const PriceLevelInfos &asks)
-      : bids_{bids}, asks_{asks} {}
+  OrderbookPriceLevelInfos(PriceLevelInfos bids, PriceLevelInfos asks)
+      : bids_{std::move(bids)}, asks_{std::move(asks)} {}
 
   const PriceLevelInfos &GetBids() const { return bids_; }
   const PriceLevelInfos &GetAsks() const { return asks_; }
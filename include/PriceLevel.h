@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+#include "OrderList.h"
+#include "Usings.h"
+
+// one price level: its FIFO of resting orders plus the remaining quantity
+// across them, kept up to date as orders are added, matched and cancelled.
+// sequence_ is the book's depth sequence at the level's last change.
+// The head, count and totals share half a cache line: quantity_ sits in the
+// list's tail padding, and a ladder gets two levels to a line.
+struct alignas(32) PriceLevel {
+  [[no_unique_address]] OrderList orders_;
+  Quantity quantity_{};
+  std::uint64_t sequence_{};
+};
+static_assert(sizeof(PriceLevel) == 32);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Order.h"
+
+// one resting order as stored in a snapshot, fixed size and native endian.
+// Orders are kept bids best first then asks best first, each level in time
+// priority, then pending stops in the order they fire, so loading them back
+// in file order restores every queue.
+struct SnapshotOrder {
+  std::uint64_t orderId_;
+  std::int64_t expiry_; // ns since the epoch, GFD and GTD only
+  std::int32_t price_;
+  std::uint32_t initialQuantity_;
+  std::uint32_t remainingQuantity_; // displayed, for an iceberg
+  std::uint32_t hiddenQuantity_;
+  std::uint32_t peakQuantity_; // icebergs only
+  std::int32_t stopPrice_;     // stop and stop limit only
+  std::uint8_t orderType_;
+  std::uint8_t side_;
+  std::uint16_t reserved_;
+
+  static SnapshotOrder FromOrder(const Order &order);
+};
+
+static_assert(sizeof(SnapshotOrder) == 48);
+static_assert(std::is_trivially_copyable_v<SnapshotOrder>);
+
+using SnapshotOrders = std::vector<SnapshotOrder>;
+
+struct SnapshotHeader {
+  static constexpr std::uint32_t Magic = 0x534f424f; // "OBOS"
+  static constexpr std::uint16_t Version = 4;
+
+  std::uint32_t magic_{Magic};
+  std::uint16_t version_{Version};
+  std::uint16_t recordSize_{sizeof(SnapshotOrder)};
+  std::uint64_t count_{};
+};
+
+static_assert(sizeof(SnapshotHeader) == 16);
+
+// writes to a temporary file, syncs it, renames it over path and syncs the
+// directory, so a crash leaves either the old snapshot or the new one
+void WriteSnapshot(const std::string &path,
+                   std::span<const SnapshotOrder> orders);
+
+// memory maps a snapshot, Orders() points straight into the mapping
+class SnapshotReader {
+public:
+  explicit SnapshotReader(const std::string &path);
+
+  std::span<const SnapshotOrder> Orders() const { return orders_; }
+
+private:
+  MappedFile file_;
+  std::span<const SnapshotOrder> orders_;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+#include "Constants.h"
+
+// bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Capacity is rounded up to a power of two so indices wrap with a mask.
+// Each side keeps a cached copy of the other side's index and only reloads the
+// shared atomic when the cache says the ring looks full (or empty).
+template <typename T> class SpscRing {
+public:
+  explicit SpscRing(std::size_t capacity)
+      : slots_(std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity)),
+        mask_{slots_.size() - 1} {}
+
+  SpscRing(const SpscRing &) = delete;
+  SpscRing &operator=(const SpscRing &) = delete;
+
+  // producer side, returns false if the ring is full
+  bool TryPush(const T &value) {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cachedHead_ == slots_.size()) {
+      cachedHead_ = head_.load(std::memory_order_acquire);
+      if (tail - cachedHead_ == slots_.size())
+        return false;
+    }
+
+    slots_[tail & mask_] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side, returns false if the ring is empty
+  bool TryPop(T &value) {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (head == cachedTail_) {
+      cachedTail_ = tail_.load(std::memory_order_acquire);
+      if (head == cachedTail_)
+        return false;
+    }
+
+    value = slots_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+  std::size_t Capacity() const { return slots_.size(); }
+
+private:
+  std::vector<T> slots_;
+  const std::size_t mask_;
+
+  // consumer owned
+  alignas(Constants::CACHE_LINE_SIZE) std::atomic<std::size_t> head_{0};
+  std::size_t cachedTail_{0};
+
+  // producer owned
+  alignas(Constants::CACHE_LINE_SIZE) std::atomic<std::size_t> tail_{0};
+  std::size_t cachedHead_{0};
+};
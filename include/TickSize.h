@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "Usings.h"
+
+// Price is fixed point: an integer count of the instrument's price unit (cents,
+// pips, 1/256ths...), so every comparison and sum on the matching path is an
+// integer one. Decimal prices only exist at the edges, converted by the
+// TickScale of the instrument. The common scales are named so the factor is a
+// compile time constant.
+template <std::int64_t UnitsPerWhole> struct TickScale {
+  static_assert(UnitsPerWhole > 0);
+  static constexpr std::int64_t Units = UnitsPerWhole;
+
+  static Price FromDecimal(double price) {
+    return static_cast<Price>(std::llround(price * UnitsPerWhole));
+  }
+  static constexpr double ToDecimal(Price price) {
+    return static_cast<double>(price) / UnitsPerWhole;
+  }
+};
+
+using WholeUnits = TickScale<1>;
+using Cents = TickScale<100>;
+using Pips = TickScale<10'000>;
+using Micros = TickScale<1'000'000>;
+
+// orders have to be priced on the instrument's tick, a whole number of price
+// units. A tick of one unit (the default) costs no division.
+inline bool IsOnTick(Price price, Price tickSize) {
+  return tickSize == 1 || price % tickSize == 0;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+#include "LatencyHistogram.h"
+
+// hot path tracing. Spans are timed with the TSC and appended to a buffer owned
+// by the recording thread, so recording takes no lock and no syscall. Buffers
+// are only read offline, once the recording threads are quiet, as per stage
+// histograms or Chrome trace JSON (chrome://tracing, Perfetto).
+//
+// TRACE_SPAN compiles to nothing unless ORDERBOOK_TRACE is defined (cmake
+// -DORDERBOOK_TRACE=ON), so the untraced build runs the exact same code.
+
+enum class TraceStage : std::uint8_t {
+  Validate,
+  Insert,
+  MatchLoop,
+  LevelBookkeeping,
+  Count,
+};
+
+constexpr std::size_t TraceStageCount =
+    static_cast<std::size_t>(TraceStage::Count);
+
+const char *ToString(TraceStage stage);
+
+inline std::uint64_t ReadTsc() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+struct TraceEvent {
+  std::uint64_t start_;
+  std::uint64_t end_;
+  TraceStage stage_;
+};
+
+// single writer ring of the newest Capacity spans of one thread
+class TraceBuffer {
+public:
+  static constexpr std::size_t Capacity = 1 << 16;
+
+  explicit TraceBuffer(std::uint32_t threadId)
+      : events_{std::make_unique<TraceEvent[]>(Capacity)},
+        threadId_{threadId} {}
+
+  void Record(TraceStage stage, std::uint64_t start, std::uint64_t end) {
+    events_[recorded_++ % Capacity] = TraceEvent{start, end, stage};
+  }
+
+  template <typename Fn> void ForEach(Fn &&fn) const {
+    const auto kept = recorded_ < Capacity ? recorded_ : Capacity;
+    for (auto i = recorded_ - kept; i < recorded_; ++i)
+      fn(events_[i % Capacity]);
+  }
+
+  std::uint32_t ThreadId() const { return threadId_; }
+  void Clear() { recorded_ = 0; }
+
+private:
+  std::unique_ptr<TraceEvent[]> events_;
+  std::uint64_t recorded_{};
+  std::uint32_t threadId_;
+};
+
+class Trace {
+public:
+  using Histograms = std::array<LatencyHistogram, TraceStageCount>;
+
+  static TraceBuffer &ThreadBuffer() {
+    thread_local TraceBuffer *buffer = Register();
+    return *buffer;
+  }
+
+  // offline readers, call once recording threads are done
+  static Histograms StageHistograms(); // in ns
+  static void WriteChromeTrace(const std::string &path);
+  static void PrintSummary(std::ostream &out);
+  static void Reset();
+
+  // measured once against steady_clock, 1 where there is no TSC
+  static double TicksPerNs();
+
+private:
+  static TraceBuffer *Register();
+};
+
+class TraceSpan {
+public:
+  explicit TraceSpan(TraceStage stage) : stage_{stage}, start_{ReadTsc()} {}
+  ~TraceSpan() { Trace::ThreadBuffer().Record(stage_, start_, ReadTsc()); }
+
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+  TraceStage stage_;
+  std::uint64_t start_;
+};
+
+#if defined(ORDERBOOK_TRACE)
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SPAN(stage) TraceSpan TRACE_CONCAT(traceSpan, __LINE__) { stage }
+#else
+#define TRACE_SPAN(stage) ((void)0)
+#endif
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Usings.h"
+
 class Trade {
 public:
   Trade(OrderId bidId, OrderId askId, Quantity quantity, Price price)
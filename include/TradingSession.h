@@ -0,0 +1,24 @@
+#pragma once
+
+#include <chrono>
+
+#include "Constants.h"
+#include "Usings.h"
+
+// when the trading day ends, GFD orders expire at the next close. Local time is
+// UTC plus utcOffset_, so a venue (or a DST switch) is a matter of options.
+struct TradingSession {
+  std::chrono::minutes utcOffset_{Constants::EASTERN_OFFSET_EDT};
+  std::chrono::minutes close_{Constants::MARKET_CLOSE_HOUR};
+
+  Timestamp NextClose(Timestamp now) const {
+    using namespace std::chrono;
+
+    const auto local = now + utcOffset_;
+    auto close = floor<days>(local) + close_;
+    if (local >= close)
+      close += days(1);
+
+    return close - utcOffset_;
+  }
+};
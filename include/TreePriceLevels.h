@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory_resource>
+#include <type_traits>
+
+#include "OrderbookOptions.h"
+#include "PriceLevel.h"
+#include "Side.h"
+#include "Usings.h"
+
+// one side of the book as a red-black tree keyed by price, best price first
+template <Side S> class TreePriceLevels {
+public:
+  using Compare = std::conditional_t<S == Side::Buy, std::greater<Price>,
+                                     std::less<Price>>;
+
+  TreePriceLevels(std::pmr::memory_resource *resource,
+                  const OrderbookOptions &)
+      : levels_{resource} {}
+
+  bool empty() const { return levels_.empty(); }
+  std::size_t size() const { return levels_.size(); }
+
+  // a tree holds any price
+  bool CanHold(Price) const { return true; }
+  bool CanSpan(std::int64_t, std::int64_t) const { return true; }
+
+  PriceLevel &operator[](Price price) { return levels_[price]; }
+  PriceLevel &at(Price price) { return levels_.at(price); }
+  void erase(Price price) { levels_.erase(price); }
+
+  Price BestPrice() const { return levels_.begin()->first; }
+  PriceLevel &Best() { return levels_.begin()->second; }
+  Price WorstPrice() const { return levels_.rbegin()->first; }
+
+  // visits levels best first, stops early if fn returns false
+  template <typename Fn> void ForEach(Fn &&fn) const {
+    for (const auto &[price, orders] : levels_) {
+      if constexpr (std::is_same_v<std::invoke_result_t<Fn &, Price,
+                                                        const PriceLevel &>,
+                                   bool>) {
+        if (!fn(price, orders))
+          return;
+      } else
+        fn(price, orders);
+    }
+  }
+
+private:
+  std::pmr::map<Price, PriceLevel, Compare> levels_;
+};
+
+struct TreeLevels {
+  template <Side S> using Levels = TreePriceLevels<S>;
+};
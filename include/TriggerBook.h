@@ -0,0 +1,75 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory_resource>
+
+#include "Order.h"
+#include "OrderList.h"
+#include "Usings.h"
+
+// pending stop and stop limit orders by trigger price, a FIFO per price. Buy
+// stops fire once a trade prints at or above their stop price and sell stops
+// at or below, so each side is kept in the order it fires: releasing only ever
+// looks at the front, and costs nothing per stop that is not triggered.
+class TriggerBook {
+public:
+  explicit TriggerBook(std::pmr::memory_resource *resource)
+      : buys_{resource}, sells_{resource} {}
+
+  bool empty() const { return buys_.empty() && sells_.empty(); }
+
+  void Add(Order *order) {
+    if (order->GetSide() == Side::Buy)
+      buys_[order->GetStopPrice()].push_back(order);
+    else
+      sells_[order->GetStopPrice()].push_back(order);
+  }
+
+  void Remove(Order *order) {
+    if (order->GetSide() == Side::Buy)
+      Remove(buys_, order);
+    else
+      Remove(sells_, order);
+  }
+
+  // takes out the next stop a trade at lastPrice fires, earliest stop price
+  // first and in time priority within it, nullptr once there is none
+  Order *PopTriggered(Price lastPrice) {
+    if (!buys_.empty() && buys_.begin()->first <= lastPrice)
+      return PopFront(buys_);
+    if (!sells_.empty() && sells_.begin()->first >= lastPrice)
+      return PopFront(sells_);
+    return nullptr;
+  }
+
+  // visits pending stops buys then sells, each in the order they would fire
+  template <typename Fn> void ForEach(Fn &&fn) const {
+    for (const auto &[_, orders] : buys_)
+      for (const auto *order : orders)
+        fn(*order);
+    for (const auto &[_, orders] : sells_)
+      for (const auto *order : orders)
+        fn(*order);
+  }
+
+private:
+  template <typename Levels> static void Remove(Levels &levels, Order *order) {
+    const auto level = levels.find(order->GetStopPrice());
+    level->second.erase(order);
+    if (level->second.empty())
+      levels.erase(level);
+  }
+
+  template <typename Levels> static Order *PopFront(Levels &levels) {
+    const auto level = levels.begin();
+    Order *order = level->second.front();
+    level->second.pop_front();
+    if (level->second.empty())
+      levels.erase(level);
+    return order;
+  }
+
+  std::pmr::map<Price, OrderList> buys_;
+  std::pmr::map<Price, OrderList, std::greater<Price>> sells_;
+};
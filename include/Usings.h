@@ -1,9 +1,12 @@
 #pragma once
 
+#include <chrono>
 #include <vector>
 #include <cstdint>
 
 using Price = std::int32_t;
 using Quantity = std::uint32_t;
 using OrderId = std::uint64_t;
-using OrderIds = std::vector<OrderId>;
\ No newline at end of file
+using OrderIds = std::vector<OrderId>;
+using InstrumentId = std::uint32_t;
+using Timestamp = std::chrono::sys_time<std::chrono::nanoseconds>;
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "CommandText.h"
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+#include "Journal.h"
+
+namespace {
+
+// takes the next space separated field off the front of line
+std::string_view NextField(std::string_view &line) {
+  const auto start = line.find_first_not_of(' ');
+  if (start == std::string_view::npos) {
+    line = {};
+    return {};
+  }
+
+  line.remove_prefix(start);
+  const auto end = std::min(line.find(' '), line.size());
+  const auto field = line.substr(0, end);
+  line.remove_prefix(end);
+  return field;
+}
+
+template <typename Number>
+Number ParseNumber(std::string_view field, std::string_view line) {
+  Number value{};
+  const auto [end, error] =
+      std::from_chars(field.data(), field.data() + field.size(), value);
+  if (field.empty() || error != std::errc{} ||
+      end != field.data() + field.size())
+    throw std::logic_error(
+        std::format("({}) has a bad number: '{}'.", line, field));
+  return value;
+}
+
+OrderType ParseOrderType(std::string_view field, std::string_view line) {
+  if (field == "GTC")
+    return OrderType::GoodTillCancel;
+  if (field == "GFD")
+    return OrderType::GoodForDay;
+  if (field == "FAK")
+    return OrderType::FillAndKill;
+  if (field == "FOK")
+    return OrderType::FillOrKill;
+  if (field == "M")
+    return OrderType::Market;
+  throw std::logic_error(
+      std::format("({}) has an unknown order type: '{}'.", line, field));
+}
+
+Side ParseSide(std::string_view field, std::string_view line) {
+  if (field == "B")
+    return Side::Buy;
+  if (field == "S")
+    return Side::Sell;
+  throw std::logic_error(
+      std::format("({}) has an unknown side: '{}'.", line, field));
+}
+
+} // namespace
+
+Command ParseCommand(std::string_view line) {
+  auto rest = line;
+  const auto action = NextField(rest);
+
+  Command command;
+  if (action == "A") {
+    command.type_ = CommandType::Add;
+    command.orderType_ = ParseOrderType(NextField(rest), line);
+    command.orderId_ = ParseNumber<OrderId>(NextField(rest), line);
+    command.side_ = ParseSide(NextField(rest), line);
+    command.price_ = ParseNumber<Price>(NextField(rest), line);
+    command.quantity_ = ParseNumber<Quantity>(NextField(rest), line);
+  } else if (action == "M") {
+    command.type_ = CommandType::Modify;
+    command.orderId_ = ParseNumber<OrderId>(NextField(rest), line);
+    command.price_ = ParseNumber<Price>(NextField(rest), line);
+    command.quantity_ = ParseNumber<Quantity>(NextField(rest), line);
+  } else if (action == "C") {
+    command.type_ = CommandType::Cancel;
+    command.orderId_ = ParseNumber<OrderId>(NextField(rest), line);
+  } else {
+    throw std::logic_error(std::format("({}) is not a command.", line));
+  }
+
+  if (!NextField(rest).empty())
+    throw std::logic_error(std::format("({}) has trailing fields.", line));
+  return command;
+}
+
+std::size_t ConvertTextToJournal(const std::string &textPath,
+                                 const std::string &journalPath,
+                                 InstrumentId instrumentId) {
+  std::ifstream text{textPath};
+  if (!text)
+    throw std::logic_error(
+        std::format("Command file {} could not be opened.", textPath));
+
+  // the writer appends, a conversion always starts a fresh journal
+  std::filesystem::remove(journalPath);
+  JournalWriter journal{journalPath};
+
+  std::size_t count{};
+  std::string line;
+  while (std::getline(text, line)) {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line.empty() || line.front() == 'R')
+      continue;
+
+    auto command = ParseCommand(line);
+    command.instrumentId_ = instrumentId;
+    journal.Append(command);
+    ++count;
+  }
+  return count;
+}
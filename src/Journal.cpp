@@ -0,0 +1,142 @@
+#include "Journal.h"
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+JournalRecord JournalRecord::FromCommand(const Command &command) {
+  return JournalRecord{command.orderId_,
+                       command.expiry_.time_since_epoch().count(),
+                       command.price_,
+                       command.quantity_,
+                       command.instrumentId_,
+                       command.stopPrice_,
+                       command.peak_,
+                       static_cast<std::uint8_t>(command.type_),
+                       static_cast<std::uint8_t>(command.orderType_),
+                       static_cast<std::uint8_t>(command.side_),
+                       0};
+}
+
+Command JournalRecord::ToCommand() const {
+  return Command{static_cast<CommandType>(type_),
+                 static_cast<OrderType>(orderType_),
+                 static_cast<Side>(side_),
+                 orderId_,
+                 price_,
+                 quantity_,
+                 instrumentId_,
+                 Timestamp{std::chrono::nanoseconds{expiry_}},
+                 stopPrice_,
+                 peak_};
+}
+
+JournalWriter::JournalWriter(const std::string &path, std::size_t batch) {
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (fd_ < 0)
+    throw std::logic_error(std::format("Journal {} could not be opened ({}).",
+                                       path, std::strerror(errno)));
+
+  try {
+    struct stat info{};
+    if (::fstat(fd_, &info) != 0)
+      throw std::logic_error(
+          std::format("Journal {} could not be inspected.", path));
+    const auto size = static_cast<std::size_t>(info.st_size);
+
+    // a header torn by a crash while creating the file holds no records, so
+    // the file starts over
+    if (size < sizeof(JournalHeader)) {
+      if (::ftruncate(fd_, 0) != 0)
+        throw std::logic_error(
+            std::format("Journal {} could not be truncated.", path));
+      const JournalHeader header;
+      Write(&header, sizeof(header));
+    } else {
+      JournalHeader header;
+      if (::pread(fd_, &header, sizeof(header), 0) !=
+              static_cast<ssize_t>(sizeof(header)) ||
+          !header.IsValid())
+        throw std::logic_error(
+            std::format("Journal {} has a bad header.", path));
+
+      // a record torn by a crash is cut off, appending after it would shift
+      // every later record off the record grid
+      const auto whole = sizeof(JournalHeader) +
+                         (size - sizeof(JournalHeader)) /
+                             sizeof(JournalRecord) * sizeof(JournalRecord);
+      if (whole != size && ::ftruncate(fd_, static_cast<off_t>(whole)) != 0)
+        throw std::logic_error(
+            std::format("Journal {} could not be truncated.", path));
+    }
+  } catch (...) {
+    // the destructor does not run when the constructor throws
+    ::close(fd_);
+    throw;
+  }
+
+  buffer_.reserve(batch);
+}
+
+JournalWriter::~JournalWriter() {
+  if (fd_ < 0)
+    return;
+
+  Flush();
+  ::close(fd_);
+}
+
+void JournalWriter::Append(const Command &command) {
+  buffer_.push_back(JournalRecord::FromCommand(command));
+  if (buffer_.size() == buffer_.capacity())
+    Flush();
+}
+
+void JournalWriter::Flush() {
+  if (buffer_.empty())
+    return;
+
+  Write(buffer_.data(), buffer_.size() * sizeof(JournalRecord));
+  buffer_.clear();
+}
+
+void JournalWriter::Sync() {
+  Flush();
+  ::fdatasync(fd_);
+}
+
+void JournalWriter::Write(const void *data, std::size_t size) {
+  const auto *bytes = static_cast<const char *>(data);
+  while (size != 0) {
+    const auto written = ::write(fd_, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      throw std::logic_error(
+          std::format("Journal write failed ({}).", std::strerror(errno)));
+    }
+    bytes += written;
+    size -= static_cast<std::size_t>(written);
+  }
+}
+
+JournalReader::JournalReader(const std::string &path) : file_{path} {
+  JournalHeader header;
+  if (file_.Size() < sizeof(header))
+    throw std::logic_error(std::format("Journal {} has no header.", path));
+
+  std::memcpy(&header, file_.Data(), sizeof(header));
+  if (!header.IsValid())
+    throw std::logic_error(std::format("Journal {} has a bad header.", path));
+
+  // the header is 16 bytes, so records stay aligned within the mapping
+  const auto *first = reinterpret_cast<const JournalRecord *>(
+      file_.Data() + sizeof(JournalHeader));
+  records_ = {first,
+              (file_.Size() - sizeof(JournalHeader)) / sizeof(JournalRecord)};
+}
@@ -0,0 +1,39 @@
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &path) {
+  const auto fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::logic_error(std::format("File {} could not be opened ({}).",
+                                       path, std::strerror(errno)));
+
+  struct stat info{};
+  if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    throw std::logic_error(std::format("File {} is empty.", path));
+  }
+
+  size_ = static_cast<std::size_t>(info.st_size);
+  auto *mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd); // the mapping keeps the file alive
+  if (mapping == MAP_FAILED)
+    throw std::logic_error(std::format("File {} could not be mapped ({}).",
+                                       path, std::strerror(errno)));
+
+  // every reader goes front to back once
+  ::madvise(mapping, size_, MADV_SEQUENTIAL);
+  data_ = static_cast<const std::byte *>(mapping);
+}
+
+MappedFile::~MappedFile() {
+  ::munmap(const_cast<std::byte *>(data_), size_);
+}
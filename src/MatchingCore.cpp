@@ -0,0 +1,206 @@
+#include "MatchingCore.h"
+
+#include "CpuAffinity.h"
+
+namespace {
+Timestamp Now() {
+  return std::chrono::time_point_cast<Timestamp::duration>(
+      std::chrono::system_clock::now());
+}
+} // namespace
+
+MatchingCore::MatchingCore(const MatchingCoreOptions &options)
+    : session_{options.book_.session_},
+      expiryBatch_{std::max<std::size_t>(options.book_.expiryBatch_, 1)} {
+  if (!options.journal_.empty())
+    journal_ = std::make_unique<JournalWriter>(options.journal_);
+  for (const auto instrumentId : options.instruments_) {
+    auto book = options.book_;
+    if (const auto tick = options.tickSizes_.find(instrumentId);
+        tick != options.tickSizes_.end())
+      book.tickSize_ = tick->second;
+    books_.try_emplace(instrumentId,
+                       Book{std::make_unique<SingleWriterOrderbook>(book), {}});
+  }
+  for (std::size_t i = 0; i < options.gateways_; ++i)
+    gateways_.push_back(std::make_unique<Gateway>(options.ringCapacity_));
+
+  thread_ = std::thread{[this]() { Run(); }};
+  PinThread(thread_, options.cpu_);
+}
+
+MatchingCore::~MatchingCore() { Stop(); }
+
+void MatchingCore::Stop() {
+  running_.store(false, std::memory_order_release);
+  if (thread_.joinable())
+    thread_.join();
+}
+
+bool MatchingCore::Submit(std::size_t gateway, const Command &command) {
+  return gateways_[gateway]->commands_.TryPush(command);
+}
+
+bool MatchingCore::Poll(std::size_t gateway, Report &report) {
+  return gateways_[gateway]->reports_.TryPop(report);
+}
+
+void MatchingCore::Run() {
+  Command command;
+  std::size_t sinceExpiryCheck = 0;
+
+  while (running_.load(std::memory_order_acquire)) {
+    bool idle = true;
+
+    // round robin so one busy gateway cannot starve the others
+    for (std::size_t gateway = 0; gateway < gateways_.size(); ++gateway) {
+      if (!gateways_[gateway]->commands_.TryPop(command))
+        continue;
+
+      Process(gateway, command);
+      idle = false;
+      ++sinceExpiryCheck;
+    }
+
+    // due expiries are worked through a bounded batch at a time, when idle
+    // and every so many commands, so a core that never goes quiet still
+    // expires its orders
+    if (idle || sinceExpiryCheck >= Constants::EXPIRY_CHECK_INTERVAL) {
+      sinceExpiryCheck = 0;
+      if (const auto now = Now(); now >= nextExpiry_)
+        Expire(now);
+    }
+
+    if (!idle)
+      continue;
+
+    // quiet moments push out whatever the journal has batched so far
+    if (journal_)
+      journal_->Flush();
+    CpuRelax();
+  }
+}
+
+void MatchingCore::Expire(Timestamp now) {
+  // journaled with the time it ran at, so a replay expires the same orders
+  const auto command =
+      Command::Expire(now, static_cast<Quantity>(expiryBatch_));
+  if (journal_)
+    journal_->Append(command);
+
+  nextExpiry_ = Timestamp::max();
+  for (auto &[_, book] : books_) {
+    book.orders_->ProcessCommands(std::span{&command, 1}, trades_);
+    nextExpiry_ = std::min(nextExpiry_, book.orders_->NextExpiry());
+    ForgetGone(book);
+  }
+}
+
+void MatchingCore::Process(std::size_t gateway, const Command &request) {
+  if (request.type_ == CommandType::PruneGoodForDay ||
+      request.type_ == CommandType::Expire) {
+    if (journal_)
+      journal_->Append(request);
+    for (auto &[_, book] : books_) {
+      book.orders_->ProcessCommands(std::span{&request, 1}, trades_);
+      ForgetGone(book);
+    }
+    Publish(*gateways_[gateway], Report::Accepted(request));
+    return;
+  }
+
+  // a GFD order gets its close here rather than in the book, so the journal
+  // holds it and a replay on another day expires it the same way
+  auto command = request;
+  if (command.type_ == CommandType::Add &&
+      command.orderType_ == OrderType::GoodForDay &&
+      command.expiry_ == Timestamp{})
+    command.expiry_ = session_.NextClose(Now());
+
+  // adds must bring a new id, cancels and modifies must name a resting order,
+  // auction commands only name the book. Malformed commands never reach the
+  // journal.
+  const auto found = books_.find(command.instrumentId_);
+  const bool namesOrder = command.type_ == CommandType::Add ||
+                          command.type_ == CommandType::Cancel ||
+                          command.type_ == CommandType::Modify;
+  if (found == books_.end() || !command.IsWellFormed() ||
+      (namesOrder && found->second.orders_->Contains(command.orderId_) !=
+                         (command.type_ != CommandType::Add))) {
+    Publish(*gateways_[gateway], Report::Rejected(command));
+    return;
+  }
+  auto &book = *found->second.orders_;
+
+  // written ahead of matching, replaying it rebuilds the same books
+  if (journal_)
+    journal_->Append(command);
+
+  trades_.clear();
+  book.ProcessCommands(std::span{&command, 1}, trades_);
+
+  if (command.type_ == CommandType::Add &&
+      (command.orderType_ == OrderType::GoodForDay ||
+       command.orderType_ == OrderType::GoodTillDate))
+    nextExpiry_ = std::min(nextExpiry_, book.NextExpiry());
+
+  // an order that neither traded nor rests was killed (FAK, FOK, market)
+  if (command.type_ == CommandType::Add && trades_.empty() &&
+      !book.Contains(command.orderId_)) {
+    Publish(*gateways_[gateway], Report::Rejected(command));
+    return;
+  }
+
+  auto &owners = found->second.owners_;
+  if (command.type_ == CommandType::Add && book.Contains(command.orderId_))
+    owners.emplace(command.orderId_, gateway);
+  else if (command.type_ == CommandType::Cancel)
+    owners.erase(command.orderId_);
+
+  Publish(*gateways_[gateway], Report::Accepted(command));
+  PublishTrades(gateway, command, found->second);
+}
+
+void MatchingCore::PublishTrades(std::size_t gateway, const Command &command,
+                                 Book &book) {
+  for (const auto &trade : trades_) {
+    const auto report = Report::FromTrade(command, trade);
+    Publish(*gateways_[gateway], report);
+
+    // the resting side hears about its fill on its own gateway, once even
+    // when it owns both sides
+    std::size_t told = gateway;
+    for (const auto orderId : {trade.GetBidId(), trade.GetAskId()}) {
+      const auto owner = book.owners_.find(orderId);
+      if (owner == book.owners_.end())
+        continue;
+      if (owner->second != gateway && owner->second != told) {
+        Publish(*gateways_[owner->second], report);
+        told = owner->second;
+      }
+    }
+  }
+
+  for (const auto &trade : trades_)
+    for (const auto orderId : {trade.GetBidId(), trade.GetAskId()})
+      if (!book.orders_->Contains(orderId))
+        book.owners_.erase(orderId);
+}
+
+void MatchingCore::ForgetGone(Book &book) {
+  // expiries and prunes remove orders without naming them, their owners are
+  // dropped once they make up most of the map
+  if (book.owners_.size() <= 2 * book.orders_->Size() + 64)
+    return;
+  std::erase_if(book.owners_, [&book](const auto &owner) {
+    return !book.orders_->Contains(owner.first);
+  });
+}
+
+void MatchingCore::Publish(Gateway &gateway, const Report &report) {
+  // backpressure: a gateway that stops draining its reports stalls matching
+  // rather than losing fills, until the core is stopped
+  while (!gateway.reports_.TryPush(report) &&
+         running_.load(std::memory_order_acquire))
+    CpuRelax();
+}
@@ -0,0 +1,73 @@
+#include "MatchingEngine.h"
+
+#include <stdexcept>
+
+#include "CpuAffinity.h"
+
+MatchingEngine::MatchingEngine(std::span<const InstrumentId> instruments,
+                               const MatchingEngineOptions &options)
+    : pollCursors_(options.gateways_), pruneGateway_{options.gateways_} {
+  if (options.workers_ == 0)
+    throw std::logic_error("Matching engine needs at least one worker.");
+
+  std::vector<std::vector<InstrumentId>> shards(options.workers_);
+  for (const auto instrumentId : instruments)
+    shards[instrumentId % options.workers_].push_back(instrumentId);
+
+  for (std::size_t worker = 0; worker < options.workers_; ++worker) {
+    MatchingCoreOptions core;
+    core.gateways_ = options.gateways_ + 1;
+    core.ringCapacity_ = options.ringCapacity_;
+    core.cpu_ = worker < options.cpus_.size() ? options.cpus_[worker] : -1;
+    core.instruments_ = std::move(shards[worker]);
+    core.book_ = options.book_;
+    core.tickSizes_ = options.tickSizes_;
+    workers_.push_back(std::make_unique<MatchingCore>(core));
+  }
+}
+
+MatchingEngine::~MatchingEngine() { Stop(); }
+
+void MatchingEngine::Stop() {
+  for (auto &worker : workers_)
+    worker->Stop();
+}
+
+std::size_t MatchingEngine::Workers() const { return workers_.size(); }
+
+std::size_t MatchingEngine::WorkerOf(InstrumentId instrumentId) const {
+  return instrumentId % workers_.size();
+}
+
+bool MatchingEngine::Submit(std::size_t gateway, const Command &command) {
+  return workers_[WorkerOf(command.instrumentId_)]->Submit(gateway, command);
+}
+
+bool MatchingEngine::Poll(std::size_t gateway, Report &report) {
+  // resume after the worker that reported last so none is starved
+  auto &cursor = pollCursors_[gateway].next_;
+  for (std::size_t i = 0; i < workers_.size(); ++i) {
+    const auto worker = (cursor + i) % workers_.size();
+    if (workers_[worker]->Poll(gateway, report)) {
+      cursor = worker + 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+void MatchingEngine::PruneGoodForDay() {
+  // goes through the rings like any command, so each worker journals it
+  std::scoped_lock pruneLock{pruneMutex_};
+
+  const auto command = Command::PruneGoodForDay();
+  for (auto &worker : workers_)
+    while (!worker->Submit(pruneGateway_, command))
+      CpuRelax();
+
+  // each worker acks its prune once all of its books are done
+  Report report;
+  for (auto &worker : workers_)
+    while (!worker->Poll(pruneGateway_, report))
+      CpuRelax();
+}
@@ -1,11 +1,24 @@
 #include "Order.h"
 
-#include <cmath>
+#include <algorithm>
 #include <exception>
 #include <format>
 
+Order Order::Iceberg(OrderType orderType, OrderId orderId, Side side,
+                     Price price, Quantity quantity, Quantity peak,
+                     Timestamp expiry) {
+  if (!CanBeIceberg(orderType))
+    throw std::logic_error(std::format(
+        "Order ({}) cannot be an iceberg, only resting orders can.", orderId));
+
+  Order order{orderType, orderId, side, price, quantity, expiry};
+  order.peakQuantity_ = peak;
+  order.Replace(price, quantity);
+  return order;
+}
+
 Quantity Order::GetFilledQuantity() const {
-  return GetInitialQuantity() - GetRemainingQuantity();
+  return GetInitialQuantity() - GetOpenQuantity();
 }
 
 void Order::Fill(Quantity quantity) {
@@ -17,7 +30,63 @@ void Order::Fill(Quantity quantity) {
   remainingQuantity_ -= quantity;
 }
 
-bool Order::IsFilled() const { return GetRemainingQuantity() == 0; }
+void Order::ReduceQuantity(Quantity quantity) {
+  if (quantity > GetOpenQuantity())
+    throw std::logic_error(std::format(
+        "Order ({}) cannot be reduced by more than its open quantity.",
+        GetOrderId()));
+
+  // an iceberg gives up its reserve before what it shows
+  const auto fromReserve = std::min(quantity, hiddenQuantity_);
+  hiddenQuantity_ -= fromReserve;
+  remainingQuantity_ -= quantity - fromReserve;
+  initialQuantity_ -= quantity;
+}
+
+// the order starts over at a new price and size, as if newly entered
+void Order::Replace(Price price, Quantity quantity) {
+  price_ = price;
+  initialQuantity_ = quantity;
+  remainingQuantity_ = peakQuantity_ ? std::min(peakQuantity_, quantity)
+                                     : quantity;
+  hiddenQuantity_ = quantity - remainingQuantity_;
+}
+
+bool Order::IsFilled() const { return GetOpenQuantity() == 0; }
+
+// shows the next peak, or whatever is left of the reserve below a peak
+void Order::Replenish() {
+  if (!IsDepleted())
+    throw std::logic_error(std::format(
+        "Order ({}) cannot be replenished while it still shows quantity.",
+        GetOrderId()));
+
+  remainingQuantity_ = std::min(peakQuantity_, hiddenQuantity_);
+  hiddenQuantity_ -= remainingQuantity_;
+}
+
+// puts back the displayed and hidden quantity a snapshot saved
+void Order::Restore(Quantity displayed, Quantity hidden) {
+  if (displayed + hidden > GetInitialQuantity())
+    throw std::logic_error(std::format(
+        "Order ({}) cannot be restored with more than its initial quantity.",
+        GetOrderId()));
+
+  remainingQuantity_ = displayed;
+  hiddenQuantity_ = hidden;
+}
+
+// what a fired stop enters the book as, for whatever it has left
+Order Order::Triggered() const {
+  if (GetOrderType() == OrderType::Stop)
+    return Order{GetOrderId(), GetSide(), GetRemainingQuantity()};
+  if (GetOrderType() == OrderType::StopLimit)
+    return Order{OrderType::GoodTillCancel, GetOrderId(), GetSide(), GetPrice(),
+                 GetRemainingQuantity()};
+
+  throw std::logic_error(std::format(
+      "Order ({}) cannot be triggered, only stop orders can.", GetOrderId()));
+}
 
 void Order::ToFillAndKill(Price price) {
   if (GetOrderType() != OrderType::Market)
@@ -25,10 +94,6 @@ void Order::ToFillAndKill(Price price) {
         "Order ({}) cannot have its price adjusted, only market orders can.",
         GetOrderId()));
 
-  if (!std::isfinite(price))
-    throw std::logic_error(
-        std::format("Order ({}) must be a tradable price.", GetOrderId()));
-
   price_ = price;
   orderType_ = OrderType::FillAndKill;
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "Snapshot.h"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+SnapshotOrder SnapshotOrder::FromOrder(const Order &order) {
+  return SnapshotOrder{order.GetOrderId(),
+                       order.GetExpiry().time_since_epoch().count(),
+                       order.GetPrice(),
+                       order.GetInitialQuantity(),
+                       order.GetRemainingQuantity(),
+                       order.GetHiddenQuantity(),
+                       order.GetPeakQuantity(),
+                       order.GetStopPrice(),
+                       static_cast<std::uint8_t>(order.GetOrderType()),
+                       static_cast<std::uint8_t>(order.GetSide()),
+                       0};
+}
+
+namespace {
+// the path's directory, so the rename that published it can be synced
+std::string DirectoryOf(const std::string &path) {
+  const auto parent = std::filesystem::path{path}.parent_path();
+  return parent.empty() ? std::string{"."} : parent.string();
+}
+
+void WriteAll(int fd, const void *data, std::size_t size,
+              const std::string &path) {
+  const auto *bytes = static_cast<const char *>(data);
+  while (size != 0) {
+    const auto written = ::write(fd, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      throw std::logic_error(
+          std::format("Snapshot {} could not be written ({}).", path,
+                      std::strerror(errno)));
+    }
+    bytes += written;
+    size -= static_cast<std::size_t>(written);
+  }
+}
+} // namespace
+
+void WriteSnapshot(const std::string &path,
+                   std::span<const SnapshotOrder> orders) {
+  const auto temporary = path + ".tmp";
+  const auto fd =
+      ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    throw std::logic_error(std::format("Snapshot {} could not be opened ({}).",
+                                       temporary, std::strerror(errno)));
+
+  // the data has to be on disk before the rename makes it the snapshot, or a
+  // crash could leave the new name on an empty or partial file
+  try {
+    SnapshotHeader header;
+    header.count_ = orders.size();
+    WriteAll(fd, &header, sizeof(header), temporary);
+    WriteAll(fd, orders.data(), orders.size_bytes(), temporary);
+    if (::fsync(fd) != 0)
+      throw std::logic_error(
+          std::format("Snapshot {} could not be synced ({}).", temporary,
+                      std::strerror(errno)));
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+  ::close(fd);
+
+  std::filesystem::rename(temporary, path);
+
+  // and the rename itself only survives a crash once the directory is synced
+  const auto directory = DirectoryOf(path);
+  const auto dirFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dirFd < 0)
+    throw std::logic_error(std::format("Directory {} could not be opened ({}).",
+                                       directory, std::strerror(errno)));
+  const auto synced = ::fsync(dirFd);
+  ::close(dirFd);
+  if (synced != 0)
+    throw std::logic_error(std::format("Directory {} could not be synced.",
+                                       directory));
+}
+
+SnapshotReader::SnapshotReader(const std::string &path) : file_{path} {
+  SnapshotHeader header;
+  if (file_.Size() < sizeof(header))
+    throw std::logic_error(std::format("Snapshot {} has no header.", path));
+
+  std::memcpy(&header, file_.Data(), sizeof(header));
+  if (header.magic_ != SnapshotHeader::Magic ||
+      header.version_ != SnapshotHeader::Version ||
+      header.recordSize_ != sizeof(SnapshotOrder) ||
+      file_.Size() != sizeof(header) + header.count_ * sizeof(SnapshotOrder))
+    throw std::logic_error(std::format("Snapshot {} is corrupt.", path));
+
+  // the header is 16 bytes, so orders stay aligned within the mapping
+  orders_ = {reinterpret_cast<const SnapshotOrder *>(file_.Data() +
+                                                     sizeof(SnapshotHeader)),
+             header.count_};
+}
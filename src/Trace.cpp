@@ -0,0 +1,132 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace {
+struct Registry {
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<TraceBuffer>> buffers_;
+};
+
+// buffers outlive their threads so a dump still sees what exited threads did
+Registry &GetRegistry() {
+  static Registry registry;
+  return registry;
+}
+} // namespace
+
+const char *ToString(TraceStage stage) {
+  switch (stage) {
+  case TraceStage::Validate:
+    return "validate";
+  case TraceStage::Insert:
+    return "insert";
+  case TraceStage::MatchLoop:
+    return "match loop";
+  case TraceStage::LevelBookkeeping:
+    return "level bookkeeping";
+  case TraceStage::Count:
+    break;
+  }
+  return "unknown";
+}
+
+TraceBuffer *Trace::Register() {
+  auto &registry = GetRegistry();
+  std::scoped_lock registryLock{registry.mutex_};
+
+  const auto threadId = static_cast<std::uint32_t>(registry.buffers_.size());
+  registry.buffers_.push_back(std::make_unique<TraceBuffer>(threadId));
+  return registry.buffers_.back().get();
+}
+
+double Trace::TicksPerNs() {
+#if defined(__x86_64__) || defined(__i386__)
+  static const double ticksPerNs = []() {
+    using namespace std::chrono;
+
+    const auto start = steady_clock::now();
+    const auto startTicks = ReadTsc();
+    while (steady_clock::now() - start < milliseconds(20))
+      ;
+    const auto ticks = ReadTsc() - startTicks;
+    const auto elapsed =
+        duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    return static_cast<double>(ticks) / static_cast<double>(elapsed);
+  }();
+  return ticksPerNs;
+#else
+  return 1.0;
+#endif
+}
+
+Trace::Histograms Trace::StageHistograms() {
+  auto &registry = GetRegistry();
+  std::scoped_lock registryLock{registry.mutex_};
+
+  const auto ticksPerNs = TicksPerNs();
+  Histograms histograms;
+  for (const auto &buffer : registry.buffers_)
+    buffer->ForEach([&](const TraceEvent &event) {
+      histograms[static_cast<std::size_t>(event.stage_)].Record(
+          static_cast<std::uint64_t>((event.end_ - event.start_) /
+                                     ticksPerNs));
+    });
+  return histograms;
+}
+
+void Trace::WriteChromeTrace(const std::string &path) {
+  auto &registry = GetRegistry();
+  std::scoped_lock registryLock{registry.mutex_};
+
+  // timestamps are microseconds from the earliest span kept
+  std::uint64_t origin = UINT64_MAX;
+  for (const auto &buffer : registry.buffers_)
+    buffer->ForEach([&origin](const TraceEvent &event) {
+      origin = std::min(origin, event.start_);
+    });
+
+  const auto ticksPerUs = TicksPerNs() * 1000.0;
+  std::ofstream file{path};
+  file << "{\"traceEvents\":[";
+
+  bool first = true;
+  for (const auto &buffer : registry.buffers_)
+    buffer->ForEach([&](const TraceEvent &event) {
+      file << (first ? "\n" : ",\n") << "{\"name\":\""
+           << ToString(event.stage_) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+           << buffer->ThreadId()
+           << ",\"ts\":" << (event.start_ - origin) / ticksPerUs
+           << ",\"dur\":" << (event.end_ - event.start_) / ticksPerUs << "}";
+      first = false;
+    });
+
+  file << "\n]}\n";
+}
+
+void Trace::PrintSummary(std::ostream &out) {
+  const auto histograms = StageHistograms();
+  for (std::size_t stage = 0; stage < TraceStageCount; ++stage) {
+    const auto &histogram = histograms[stage];
+    if (histogram.Count() == 0)
+      continue;
+
+    out << ToString(static_cast<TraceStage>(stage))
+        << ": count=" << histogram.Count() << " p50=" << histogram.Percentile(50)
+        << "ns p99=" << histogram.Percentile(99)
+        << "ns p99.9=" << histogram.Percentile(99.9)
+        << "ns max=" << histogram.Max() << "ns\n";
+  }
+}
+
+void Trace::Reset() {
+  auto &registry = GetRegistry();
+  std::scoped_lock registryLock{registry.mutex_};
+
+  for (auto &buffer : registry.buffers_)
+    buffer->Clear();
+}
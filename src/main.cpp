@@ -1,16 +1,18 @@
 #include <iostream>
 
 #include "OrderBook.h"
-#include "Profiler.h"
+#include "Trace.h"
 
 int main() {
-  Profiler("main");
   Orderbook orderbook;
   OrderId orderId = 1;
-  orderbook.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, orderId,
-                                             Side::Buy, 100, 10));
-  orderbook.AddOrder(std::make_shared<Order>(OrderType::FillOrKill, ++orderId,
-                                             Side::Sell, 100, 15));
+  orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, orderId, Side::Buy, 100, 10});
+  orderbook.AddOrder(
+      Order{OrderType::FillOrKill, ++orderId, Side::Sell, 100, 15});
   std::cout << "After executing order: " << orderbook.Size() << std::endl;
+#if defined(ORDERBOOK_TRACE)
+  Trace::PrintSummary(std::cout);
+#endif
   return 0;
 }
\ No newline at end of file
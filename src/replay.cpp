@@ -0,0 +1,117 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "CommandText.h"
+#include "Journal.h"
+#include "OrderBook.h"
+
+// replays a journal (a capture, or text commands converted with --convert)
+// into one book straight out of the mapping, then reports how fast it went
+// and what the book looks like at the end
+namespace {
+void PrintUsage(const char *program) {
+  std::cout << "usage: " << program
+            << " JOURNAL [--instrument N] [--ladder] [--depth N]\n"
+               "       "
+            << program
+            << " --convert TEXT JOURNAL [--instrument N]\n"
+               "  --convert writes the text commands (A/M/C lines) of TEXT to\n"
+               "  a new JOURNAL, the same binary format replay reads\n";
+}
+
+void PrintLevels(std::string_view name, const PriceLevelInfos &levels) {
+  std::cout << name << ":";
+  for (const auto &level : levels)
+    std::cout << " " << level.quantity_ << "@" << level.price_;
+  std::cout << std::endl;
+}
+
+template <typename OrderbookType>
+int Replay(const std::string &path, InstrumentId instrumentId,
+           std::size_t depth) {
+  const JournalReader journal{path};
+
+  // the default capacity, the pool and id table grow with the resting orders
+  // rather than being sized for every record in the journal
+  OrderbookType orderbook;
+
+  std::uint64_t fills{};
+  std::uint64_t volume{};
+  auto Count = [&fills, &volume](const Execution &execution) {
+    ++fills;
+    volume += execution.quantity_;
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto commands = journal.Replay(orderbook, Count, instrumentId);
+  const auto end = std::chrono::steady_clock::now();
+
+  // only what reached the book counts, not other instruments' records
+  const double seconds = std::chrono::duration<double>(end - start).count();
+  std::cout << "Commands: " << commands << " of "
+            << journal.Records().size() << " records" << std::endl;
+  std::cout << "Elapsed: " << seconds * 1'000 << " ms" << std::endl;
+  std::cout << "Throughput: " << (seconds > 0 ? commands / seconds : 0)
+            << " commands/sec" << std::endl;
+  std::cout << "Fills: " << fills << " (" << volume << " traded)"
+            << std::endl;
+  std::cout << "Resting orders: " << orderbook.Size() << std::endl;
+
+  const auto book = orderbook.GetDepth(depth);
+  PrintLevels("Bids", book.GetBids());
+  PrintLevels("Asks", book.GetAsks());
+  return 0;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string convertFrom;
+  std::string journal;
+  InstrumentId instrumentId{};
+  std::size_t depth = 5;
+  bool ladder = false;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view argument = argv[i];
+    if (argument == "--convert" && i + 2 < argc) {
+      convertFrom = argv[++i];
+      journal = argv[++i];
+    } else if (argument == "--instrument" && i + 1 < argc)
+      instrumentId = static_cast<InstrumentId>(std::stoul(argv[++i]));
+    else if (argument == "--depth" && i + 1 < argc)
+      depth = std::stoul(argv[++i]);
+    else if (argument == "--ladder")
+      ladder = true;
+    else if (journal.empty() && !argument.starts_with("--"))
+      journal = argument;
+    else {
+      PrintUsage(argv[0]);
+      return argument == "--help" ? 0 : 1;
+    }
+  }
+
+  if (journal.empty()) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  try {
+    if (!convertFrom.empty()) {
+      const auto count =
+          ConvertTextToJournal(convertFrom, journal, instrumentId);
+      std::cout << "Converted " << count << " commands to " << journal
+                << std::endl;
+      return 0;
+    }
+
+    return ladder ? Replay<SingleWriterLadderOrderbook>(journal, instrumentId,
+                                                        depth)
+                  : Replay<SingleWriterOrderbook>(journal, instrumentId, depth);
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+}
@@ -1,27 +1,23 @@
 #include "pch.h"
 
-#include "../src/OrderBook.cpp"
+#include "CommandText.h"
+#include "Journal.h"
+#include "LatencyHistogram.h"
+#include "MatchingCore.h"
+#include "MatchingEngine.h"
+#include "OrderBook.h"
+#include "SpscRing.h"
+#include "Trace.h"
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace googletest = ::testing;
 
-enum class ActionType {
-  Add,
-  Modify,
-  Cancel,
-};
-
-struct Information {
-  ActionType type_;
-  OrderType orderType_;
-  Side side_;
-  Price price_;
-  Quantity quantity_;
-  OrderId orderId_;
-};
-
-using Informations = std::vector<Information>;
-
 // improvement: specify a vector of orders and compare
 struct Result {
   std::size_t allCount_;
@@ -29,115 +25,24 @@ struct Result {
   std::size_t askCount_;
 };
 
+// a fixture is text commands (see CommandText.h) ending in an R line with the
+// expected order, bid level and ask level counts
 struct InputHandler {
 private:
-  std::uint64_t ToNumber(const std::string_view &str) const {
-    std::int64_t value{};
-    std::from_chars(str.data(), str.data() + str.size(), value);
-    if (value < 0)
-      throw std::logic_error("Value is below zero.");
-    return static_cast<std::uint64_t>(value);
-  }
-
-  bool TryParseResult(const std::string_view &str, Result &result) const {
+  bool TryParseResult(std::string_view str, Result &result) const {
     if (str.at(0) != 'R')
       return false;
 
-    auto values = Split(str, ' ');
-    result.allCount_ = ToNumber(values.at(1));
-    result.bidCount_ = ToNumber(values.at(2));
-    result.askCount_ = ToNumber(values.at(3));
-
-    return true;
-  }
-
-  bool TryParseInformation(const std::string_view &str,
-                           Information &info) const {
-    auto action = str.at(0);
-    auto values = Split(str, ' ');
-    if (action == 'A') {
-      info.type_ = ActionType::Add;
-      info.orderType_ = ParseOrderType(values.at(1));
-      info.orderId_ = ParseOrderId(values.at(2));
-      info.side_ = ParseSide(values.at(3));
-      info.price_ = ParsePrice(values.at(4));
-      info.quantity_ = ParseQuantity(values.at(5));
-    } else if (action == 'M') {
-      info.type_ = ActionType::Modify;
-      info.orderId_ = ParseOrderId(values.at(1));
-      info.price_ = ParsePrice(values.at(2));
-      info.quantity_ = ParseQuantity(values.at(3));
-    } else if (action == 'C') {
-      info.type_ = ActionType::Cancel;
-      info.orderId_ = ParseOrderId(values.at(1));
-    } else
-      return false;
-
-    return true;
-  }
-
-  std::vector<std::string_view> Split(const std::string_view &str,
-                                      char delimiter) const {
-    std::vector<std::string_view> columns{};
-    std::size_t startIndex{}, endIndex{};
-    while ((endIndex = str.find(delimiter, startIndex)) &&
-           endIndex != std::string::npos) {
-      auto distance = endIndex - startIndex;
-      auto column = str.substr(startIndex, distance);
-      columns.push_back(column);
-      startIndex = endIndex + 1;
-    }
-
-    columns.push_back(str.substr(startIndex));
-    return columns;
-  }
-
-  OrderType ParseOrderType(const std::string_view &str) const {
-    if (str == "FAK")
-      return OrderType::FillAndKill;
-    else if (str == "FOK")
-      return OrderType::FillOrKill;
-    else if (str == "GFD")
-      return OrderType::GoodForDay;
-    else if (str == "GTC")
-      return OrderType::GoodTillCancel;
-    else if (str == "M")
-      return OrderType::Market;
-    else
-      throw std::logic_error(std::format("Unknown Order Type: {}", str));
-  }
-  OrderId ParseOrderId(const std::string_view &str) const {
-    if (str.empty())
-      throw std::logic_error("Order Id empty!");
-
-    return ToNumber(str);
-  }
-  Side ParseSide(const std::string_view &str) const {
-    if (str == "B")
-      return Side::Buy;
-    else if (str == "S")
-      return Side::Sell;
-    else
-      throw std::logic_error(std::format("Unknown Side: {}", str));
-  }
-  Price ParsePrice(const std::string_view &str) const {
-    if (str.empty())
-      throw std::logic_error("Price empty!");
-
-    return ToNumber(str);
-  }
-  Quantity ParseQuantity(const std::string_view &str) const {
-    if (str.empty())
-      throw std::logic_error("Quantity empty!");
-
-    return ToNumber(str);
+    std::istringstream values{std::string{str.substr(1)}};
+    return static_cast<bool>(values >> result.allCount_ >> result.bidCount_ >>
+                             result.askCount_);
   }
 
 public:
-  std::tuple<Informations, Result>
-  GetInformations(const std::filesystem::path &path) const {
-    Informations infos;
-    infos.reserve(1'000);
+  std::tuple<std::vector<Command>, Result>
+  GetCommands(const std::filesystem::path &path) const {
+    std::vector<Command> commands;
+    commands.reserve(1'000);
 
     std::string line;
     std::ifstream file{path};
@@ -145,30 +50,19 @@ public:
       if (line.empty())
         break;
 
-      const bool isResult = line.at(0) == 'R';
-      const bool isUpdate = !isResult;
-
-      if (isUpdate) {
-        Information update;
-
-        auto isValid = TryParseInformation(line, update);
-        if (!isValid)
-          throw std::logic_error(
-              std::format("({}) update command is invalid", line));
-
-        infos.push_back(update);
-      } else {
-        if (!file.eof())
-          throw std::logic_error("Result must be at the end of the file only.");
+      if (line.at(0) != 'R') {
+        commands.push_back(ParseCommand(line));
+        continue;
+      }
 
-        Result result;
+      if (!file.eof())
+        throw std::logic_error("Result must be at the end of the file only.");
 
-        auto isValid = TryParseResult(line, result);
-        if (!isValid)
-          throw std::logic_error(std::format("({}) command is invalid", line));
+      Result result;
+      if (!TryParseResult(line, result))
+        throw std::logic_error(std::format("({}) command is invalid", line));
 
-        return {infos, result};
-      }
+      return {commands, result};
     }
 
     throw std::logic_error("No result specified.");
@@ -181,35 +75,24 @@ public:
       std::filesystem::path{SOURCE_DIR} / "tests" / "TestFiles"};
 };
 
-TEST_P(OrderbookTestsFixture, OrderbookTestSuite) {
+template <typename OrderbookType>
+void RunTestFile(const std::filesystem::path &file) {
   // Arrange
-  const auto file = OrderbookTestsFixture::TestFolderPath / GetParam();
 
   InputHandler handler;
-  const auto [updates, result] = handler.GetInformations(file);
-
-  auto GetOrder = [](const Information &information) {
-    return std::make_shared<Order>(information.orderType_, information.orderId_,
-                                   information.side_, information.price_,
-                                   information.quantity_);
-  };
-
-  auto GetOrderModify = [](const Information &information) {
-    return OrderModify{information.orderId_, information.price_,
-                       information.quantity_};
-  };
+  const auto [updates, result] = handler.GetCommands(file);
 
   // Act
-  Orderbook orderbook;
+  OrderbookType orderbook;
   for (const auto &update : updates) {
     switch (update.type_) {
-    case ActionType::Add: {
-      const Trades &trades = orderbook.AddOrder(GetOrder(update));
+    case CommandType::Add: {
+      const Trades &trades = orderbook.AddOrder(update.ToOrder());
     } break;
-    case ActionType::Modify: {
-      const Trades &trades = orderbook.ModifyOrder(GetOrderModify(update));
+    case CommandType::Modify: {
+      const Trades &trades = orderbook.ModifyOrder(update.ToOrderModify());
     } break;
-    case ActionType::Cancel: {
+    case CommandType::Cancel: {
       orderbook.CancelOrder(update.orderId_);
     } break;
     default:
@@ -224,9 +107,1264 @@ TEST_P(OrderbookTestsFixture, OrderbookTestSuite) {
   ASSERT_EQ(orderbookInfos.GetAsks().size(), result.askCount_);
 }
 
+TEST_P(OrderbookTestsFixture, OrderbookTestSuite) {
+  RunTestFile<Orderbook>(OrderbookTestsFixture::TestFolderPath / GetParam());
+}
+
+TEST_P(OrderbookTestsFixture, LadderOrderbookTestSuite) {
+  RunTestFile<LadderOrderbook>(OrderbookTestsFixture::TestFolderPath /
+                               GetParam());
+}
+
 INSTANTIATE_TEST_CASE_P(
     Tests, OrderbookTestsFixture,
     googletest::ValuesIn({"Match_GoodTillCancel.txt", "Match_FillAndKill.txt",
                           "Match_FillOrKill_Hit.txt",
                           "Match_FillOrKill_Miss.txt", "Cancel_Success.txt",
-                          "Modify_Price.txt", "Match_Market.txt"}));
\ No newline at end of file
+                          "Modify_Price.txt", "Match_Market.txt",
+                          "Match_FillOrKill_Levels_Hit.txt",
+                          "Match_FillOrKill_Levels_Miss.txt",
+                          "Match_FillOrKill_AfterCancel.txt",
+                          "Modify_QuantityDown_KeepsPriority.txt",
+                          "Modify_QuantityUp_LosesPriority.txt"}));
+
+// the ladder starts narrow so prices regularly fall outside it and force the
+// base to move or the array to grow, results must match the tree exactly
+TEST(LadderOrderbookTests, MatchesTreeOrderbook) {
+  OrderbookOptions options;
+  options.ladderTicks_ = 64;
+
+  Orderbook tree;
+  LadderOrderbook ladder{options};
+
+  std::mt19937 gen{42};
+  std::uniform_int_distribution<Price> priceDist(900, 1100);
+  std::uniform_int_distribution<Quantity> quantityDist(1, 100);
+  std::uniform_int_distribution<int> actionDist(0, 9);
+  std::uniform_int_distribution<int> typeDist(0, 4);
+
+  const OrderType types[] = {OrderType::GoodTillCancel, OrderType::FillAndKill,
+                             OrderType::FillOrKill, OrderType::GoodForDay,
+                             OrderType::Market};
+
+  OrderIds activeOrders;
+  for (OrderId orderId = 1; orderId <= 20'000; ++orderId) {
+    const auto action = actionDist(gen);
+    Trades treeTrades, ladderTrades;
+
+    if (action < 6 || activeOrders.empty()) {
+      const auto side = orderId % 2 ? Side::Buy : Side::Sell;
+      const auto type = types[typeDist(gen)];
+      const auto quantity = quantityDist(gen);
+      const auto order =
+          type == OrderType::Market
+              ? Order{orderId, side, quantity}
+              : Order{type, orderId, side, priceDist(gen), quantity};
+
+      treeTrades = tree.AddOrder(order);
+      ladderTrades = ladder.AddOrder(order);
+      activeOrders.push_back(orderId);
+    } else {
+      const auto index = gen() % activeOrders.size();
+      const auto orderId = activeOrders[index];
+      activeOrders[index] = activeOrders.back();
+      activeOrders.pop_back();
+
+      if (action < 8) {
+        tree.CancelOrder(orderId);
+        ladder.CancelOrder(orderId);
+      } else {
+        const OrderModify modify{orderId, priceDist(gen), quantityDist(gen)};
+        treeTrades = tree.ModifyOrder(modify);
+        ladderTrades = ladder.ModifyOrder(modify);
+      }
+    }
+
+    ASSERT_EQ(treeTrades.size(), ladderTrades.size());
+    for (std::size_t i = 0; i < treeTrades.size(); ++i) {
+      ASSERT_EQ(treeTrades[i].GetBidId(), ladderTrades[i].GetBidId());
+      ASSERT_EQ(treeTrades[i].GetAskId(), ladderTrades[i].GetAskId());
+      ASSERT_EQ(treeTrades[i].GetPrice(), ladderTrades[i].GetPrice());
+      ASSERT_EQ(treeTrades[i].GetQuantity(), ladderTrades[i].GetQuantity());
+    }
+  }
+
+  const auto treeInfos = tree.GetOrderInfos();
+  const auto ladderInfos = ladder.GetOrderInfos();
+  ASSERT_EQ(tree.Size(), ladder.Size());
+
+  auto AssertSameLevels = [](const PriceLevelInfos &expected,
+                             const PriceLevelInfos &actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+      ASSERT_EQ(expected[i].price_, actual[i].price_);
+      ASSERT_EQ(expected[i].quantity_, actual[i].quantity_);
+    }
+  };
+  AssertSameLevels(treeInfos.GetBids(), ladderInfos.GetBids());
+  AssertSameLevels(treeInfos.GetAsks(), ladderInfos.GetAsks());
+}
+
+TEST(LadderOrderbookTests, RefusesPricesBeyondMaxTicks) {
+  LadderOrderbook orderbook{
+      OrderbookOptions{.ladderTicks_ = 64, .ladderMaxTicks_ = 256}};
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 1, Side::Buy, 100, 10});
+
+  // growing towards a price within reach is fine, a fat finger is refused
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 2, Side::Buy, 300, 10});
+  orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, 3, Side::Buy, 1'000'000'000, 10});
+  ASSERT_TRUE(orderbook.Contains(2));
+  ASSERT_FALSE(orderbook.Contains(3));
+
+  // the same goes for a modify, which leaves the order where it was
+  orderbook.ModifyOrder(OrderModify{2, 1'000'000'000, 10});
+  ASSERT_EQ(orderbook.GetDepth(1).GetBids()[0].price_, 300);
+
+  // the bound is per side, and an empty side starts over anywhere
+  orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, 4, Side::Sell, 1'000'000'000, 10});
+  ASSERT_TRUE(orderbook.Contains(4));
+  orderbook.CancelOrder(1);
+  orderbook.CancelOrder(2);
+  orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, 5, Side::Buy, 999'999'999, 10});
+  ASSERT_TRUE(orderbook.Contains(5));
+
+  // the tree has no such bound
+  Orderbook tree;
+  tree.AddOrder(Order{OrderType::GoodTillCancel, 1, Side::Buy, 100, 10});
+  tree.AddOrder(
+      Order{OrderType::GoodTillCancel, 3, Side::Buy, 1'000'000'000, 10});
+  ASSERT_TRUE(tree.Contains(3));
+}
+
+TEST(OrderTableTests, MatchesUnorderedMapUnderChurn) {
+  // a small table grows several times and erases shift long runs back
+  std::pmr::unsynchronized_pool_resource resource;
+  OrderTable table{&resource, 4};
+  std::unordered_map<OrderId, Order *> expected;
+  std::vector<Order> orders(
+      64, Order{OrderType::GoodTillCancel, 1, Side::Buy, 100, 1});
+
+  std::mt19937_64 gen{11};
+  std::vector<OrderId> live;
+  for (int i = 0; i < 20'000; ++i) {
+    // sequential and sparse ids, with a few repeats of live ones
+    const OrderId orderId = i % 3 == 0 ? gen() : gen() % 4'096;
+    if (gen() % 5 < 3) {
+      Order *order = &orders[gen() % orders.size()];
+      ASSERT_EQ(table.Insert(orderId, order),
+                expected.emplace(orderId, order).second);
+      live.push_back(orderId);
+    } else if (!live.empty()) {
+      const auto erased = live[gen() % live.size()];
+      const auto found = expected.find(erased);
+      ASSERT_EQ(table.Erase(erased),
+                found == expected.end() ? nullptr : found->second);
+      expected.erase(erased);
+    }
+    ASSERT_EQ(table.size(), expected.size());
+  }
+
+  for (const auto &[orderId, order] : expected)
+    ASSERT_EQ(table.Find(orderId), order);
+  ASSERT_FALSE(table.Contains(static_cast<OrderId>(-1)));
+}
+
+TEST(OrderPoolTests, GrowsGeometricallyFromASmallStart) {
+  OrderPool pool{4};
+  std::vector<Order *> orders;
+  for (OrderId orderId = 1; orderId <= 100; ++orderId)
+    orders.push_back(pool.Acquire(OrderType::GoodTillCancel, orderId,
+                                  Side::Buy, 100, 1));
+
+  // 4 + 4 + 8 + 16 + 32 + 64, each slab as large as the ones before it
+  ASSERT_EQ(pool.Capacity(), 128u);
+  ASSERT_EQ(pool.InUse(), 100u);
+  for (std::size_t i = 0; i < orders.size(); ++i)
+    ASSERT_EQ(orders[i]->GetOrderId(), i + 1);
+
+  for (auto *order : orders)
+    pool.Release(order);
+  ASSERT_EQ(pool.InUse(), 0u);
+}
+
+TEST(OrderbookBatchTests, BatchMatchesSequentialCalls) {
+  const std::vector<Order> orders{
+      {OrderType::GoodTillCancel, 1, Side::Buy, 100, 10},
+      {OrderType::GoodTillCancel, 2, Side::Buy, 101, 10},
+      {OrderType::GoodTillCancel, 3, Side::Sell, 103, 10},
+      {OrderType::FillAndKill, 4, Side::Sell, 100, 15},
+      {OrderType::GoodTillCancel, 5, Side::Sell, 102, 10},
+  };
+  const std::vector<OrderModify> modifies{{3, 101, 5}, {5, 99, 20}};
+  const OrderIds cancels{1, 5};
+
+  Orderbook sequential;
+  Trades expected;
+  for (const auto &order : orders)
+    std::ranges::copy(sequential.AddOrder(order), std::back_inserter(expected));
+  for (const auto &modify : modifies)
+    std::ranges::copy(sequential.ModifyOrder(modify),
+                      std::back_inserter(expected));
+  for (const auto orderId : cancels)
+    sequential.CancelOrder(orderId);
+
+  Orderbook batched;
+  Trades trades;
+  batched.AddOrders(orders, trades);
+  batched.ModifyOrders(modifies, trades);
+  batched.CancelOrders(cancels);
+
+  ASSERT_EQ(trades.size(), expected.size());
+  for (std::size_t i = 0; i < trades.size(); ++i) {
+    ASSERT_EQ(trades[i].GetBidId(), expected[i].GetBidId());
+    ASSERT_EQ(trades[i].GetAskId(), expected[i].GetAskId());
+    ASSERT_EQ(trades[i].GetQuantity(), expected[i].GetQuantity());
+  }
+  ASSERT_EQ(batched.Size(), sequential.Size());
+
+  // the same steps as commands, appended after what the buffer already holds
+  const std::vector<Command> commands{
+      Command::Add(orders[0]), Command::Add(orders[2]), Command::Cancel(1),
+      Command::Modify(OrderModify{3, 104, 1})};
+  Orderbook commanded;
+  commanded.ProcessCommands(commands, trades);
+  ASSERT_EQ(trades.size(), expected.size());
+  ASSERT_EQ(commanded.Size(), 1u);
+}
+
+TEST(OrderbookExecutionTests, SinkSeesAggressorAndRemaining) {
+  Orderbook orderbook;
+  std::vector<Execution> executions;
+  auto Collect = [&executions](const Execution &execution) {
+    executions.push_back(execution);
+  };
+
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 1, Side::Sell, 101, 5},
+                     Collect);
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 2, Side::Sell, 102, 5},
+                     Collect);
+  ASSERT_TRUE(executions.empty());
+
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 3, Side::Buy, 102, 8},
+                     Collect);
+  ASSERT_EQ(executions.size(), 2u);
+  ASSERT_EQ(executions[0].askId_, 1u);
+  ASSERT_EQ(executions[0].price_, 101);
+  ASSERT_EQ(executions[0].quantity_, 5u);
+  ASSERT_EQ(executions[0].aggressor_, Side::Buy);
+  ASSERT_EQ(executions[0].bidRemaining_, 3u);
+  ASSERT_EQ(executions[0].askRemaining_, 0u);
+  ASSERT_EQ(executions[1].askId_, 2u);
+  ASSERT_EQ(executions[1].bidRemaining_, 0u);
+  ASSERT_EQ(executions[1].askRemaining_, 2u);
+
+  // a modify that crosses is the aggressor too
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 4, Side::Buy, 100, 4},
+                     Collect);
+  orderbook.ModifyOrder(OrderModify{2, 100, 2}, Collect);
+  ASSERT_EQ(executions.size(), 3u);
+  ASSERT_EQ(executions[2].aggressor_, Side::Sell);
+  ASSERT_EQ(executions[2].bidRemaining_, 2u);
+
+  // the Trades calls are the same stream through the Trades adapter
+  const auto trades = orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, 5, Side::Sell, 100, 1});
+  ASSERT_EQ(trades.size(), 1u);
+  ASSERT_EQ(trades[0].GetBidId(), 4u);
+
+  std::size_t fills{};
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 6, Side::Sell, 100, 1},
+                     [&fills](const Execution &) { ++fills; });
+  ASSERT_EQ(fills, 1u);
+  ASSERT_FALSE(orderbook.Contains(4));
+}
+
+TEST(OrderbookSweepTests, SweepsWholeLevelsInQueueOrder) {
+  SpscRing<MarketDataEvent> ring{256};
+  Orderbook orderbook{OrderbookOptions{.marketData_ = &ring}};
+  OrderId orderId{};
+  for (Price price : {101, 102, 103})
+    for (Quantity quantity : {3u, 4u})
+      orderbook.AddOrder(Order{OrderType::GoodTillCancel, ++orderId,
+                               Side::Sell, price, quantity});
+
+  // takes 101 and 102 whole, then part of the first order at 103
+  std::vector<Execution> executions;
+  orderbook.AddOrder(Order{++orderId, Side::Buy, 16},
+                     [&executions](const Execution &execution) {
+                       executions.push_back(execution);
+                     });
+  ASSERT_EQ(executions.size(), 5u);
+  for (OrderId askId = 1; askId <= 5; ++askId)
+    ASSERT_EQ(executions[askId - 1].askId_, askId);
+  ASSERT_EQ(executions[3].bidRemaining_, 2u);
+  ASSERT_EQ(executions[4].quantity_, 2u);
+  ASSERT_EQ(executions[4].askRemaining_, 1u);
+
+  const auto asks = orderbook.GetDepth(10).GetAsks();
+  ASSERT_EQ(asks.size(), 1u);
+  ASSERT_EQ(asks[0].price_, 103);
+  ASSERT_EQ(asks[0].quantity_, 5u);
+
+  // the side total moved with the sweep: a FOK for exactly what is left fills
+  ASSERT_EQ(orderbook
+                .AddOrder(Order{OrderType::FillOrKill, ++orderId, Side::Buy,
+                                103, 5})
+                .size(),
+            2u);
+  ASSERT_EQ(orderbook.Size(), 0u);
+
+  // each swept level is deleted with a single level event
+  std::size_t deletes{};
+  MarketDataEvent event;
+  while (ring.TryPop(event))
+    deletes += event.type_ == MarketDataEventType::LevelDelete &&
+               event.side_ == Side::Sell;
+  ASSERT_EQ(deletes, 3u);
+}
+
+TEST(OrderbookTransientTests, ImmediateOrdersNeverRest) {
+  SpscRing<MarketDataEvent> ring{256};
+  Orderbook orderbook{OrderbookOptions{.marketData_ = &ring}};
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 1, Side::Sell, 101, 5});
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 2, Side::Buy, 99, 5});
+
+  // the residual of a FAK is dropped, not added and then cancelled
+  auto trades = orderbook.AddOrder(
+      Order{OrderType::FillAndKill, 3, Side::Buy, 101, 8});
+  ASSERT_EQ(trades.size(), 1u);
+  ASSERT_EQ(trades[0].GetQuantity(), 5u);
+  ASSERT_FALSE(orderbook.Contains(3));
+  ASSERT_EQ(orderbook.Size(), 1u);
+
+  // ids of resting orders are still refused
+  trades = orderbook.AddOrder(Order{OrderType::FillAndKill, 2, Side::Sell, 99,
+                                    1});
+  ASSERT_TRUE(trades.empty());
+
+  trades = orderbook.AddOrder(Order{4, Side::Sell, 2});
+  ASSERT_EQ(trades.size(), 1u);
+  ASSERT_FALSE(orderbook.Contains(4));
+  ASSERT_EQ(orderbook.GetDepth(1).GetBids()[0].quantity_, 3u);
+
+  // only resting orders show up in market data
+  MarketDataEvent event;
+  while (ring.TryPop(event)) {
+    ASSERT_NE(event.orderId_, 3u);
+    ASSERT_NE(event.orderId_, 4u);
+  }
+}
+
+TEST(OrderbookStopTests, TradesReleaseStopsAndCascades) {
+  Orderbook orderbook;
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 1, Side::Sell, 101, 5});
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 2, Side::Sell, 102, 5});
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 3, Side::Sell, 105, 5});
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 4, Side::Buy, 99, 5});
+
+  // pending stops are known to the book but not part of the depth
+  orderbook.AddOrder(Order::Stop(10, Side::Buy, 102, 5));
+  orderbook.AddOrder(Order::StopLimit(11, Side::Buy, 103, 105, 3));
+  orderbook.AddOrder(Order::Stop(12, Side::Sell, 95, 5));
+  ASSERT_TRUE(orderbook.Contains(10));
+  ASSERT_EQ(orderbook.GetDepth(1).GetBids()[0].quantity_, 5u);
+
+  // a trade below the stop price fires nothing
+  auto trades = orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, 5, Side::Buy, 101, 5});
+  ASSERT_EQ(trades.size(), 1u);
+  ASSERT_TRUE(orderbook.Contains(10));
+
+  // 102 fires stop 10, whose trades at 102 and 105 fire stop limit 11
+  trades = orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, 6, Side::Buy, 102, 1});
+  ASSERT_EQ(trades.size(), 4u);
+  ASSERT_EQ(trades[1].GetBidId(), 10u);
+  ASSERT_EQ(trades[1].GetQuantity(), 4u);
+  ASSERT_EQ(trades[2].GetBidId(), 10u);
+  ASSERT_EQ(trades[2].GetPrice(), 105);
+  ASSERT_EQ(trades[3].GetBidId(), 11u);
+  ASSERT_EQ(trades[3].GetQuantity(), 3u);
+  ASSERT_FALSE(orderbook.Contains(10));
+  ASSERT_FALSE(orderbook.Contains(11));
+  ASSERT_EQ(orderbook.GetDepth(1).GetAsks()[0].quantity_, 1u);
+
+  // cancelled before it fires, and one already through its price fires at once
+  orderbook.CancelOrder(12);
+  ASSERT_FALSE(orderbook.Contains(12));
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 7, Side::Buy, 100, 2});
+  trades = orderbook.AddOrder(Order::Stop(13, Side::Sell, 106, 3));
+  ASSERT_EQ(trades.size(), 2u);
+  ASSERT_EQ(trades[0].GetBidId(), 7u);
+  ASSERT_EQ(trades[1].GetBidId(), 4u);
+  ASSERT_FALSE(orderbook.Contains(13));
+}
+
+TEST(OrderbookIcebergTests, PeaksRequeueAtTheBackOfTheLevel) {
+  Orderbook orderbook;
+  orderbook.AddOrder(
+      Order::Iceberg(OrderType::GoodTillCancel, 1, Side::Sell, 100, 10, 3));
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 2, Side::Sell, 100, 2});
+  ASSERT_EQ(orderbook.GetDepth(1).GetAsks()[0].quantity_, 5u);
+
+  // the filled peak is shown again behind order 2
+  auto trades = orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, 3, Side::Buy, 100, 4});
+  ASSERT_EQ(trades.size(), 2u);
+  ASSERT_EQ(trades[0].GetAskId(), 1u);
+  ASSERT_EQ(trades[0].GetQuantity(), 3u);
+  ASSERT_EQ(trades[1].GetAskId(), 2u);
+  ASSERT_EQ(orderbook.GetDepth(1).GetAsks()[0].quantity_, 4u);
+
+  // sweeps take one peak at a time until the reserve runs out
+  trades = orderbook.AddOrder(
+      Order{OrderType::FillAndKill, 4, Side::Buy, 100, 9});
+  ASSERT_EQ(trades.size(), 4u);
+  ASSERT_EQ(trades[0].GetAskId(), 2u);
+  ASSERT_EQ(trades[1].GetQuantity(), 3u);
+  ASSERT_EQ(trades[2].GetQuantity(), 3u);
+  ASSERT_EQ(trades[3].GetQuantity(), 1u);
+  ASSERT_FALSE(orderbook.Contains(1));
+  ASSERT_TRUE(orderbook.GetDepth(1).GetAsks().empty());
+
+  // an incoming iceberg keeps matching peak after peak
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 5, Side::Sell, 101, 5});
+  trades = orderbook.AddOrder(
+      Order::Iceberg(OrderType::GoodTillCancel, 6, Side::Buy, 101, 6, 2));
+  ASSERT_EQ(trades.size(), 3u);
+  ASSERT_EQ(trades[2].GetQuantity(), 1u);
+  ASSERT_EQ(orderbook.GetDepth(1).GetBids()[0].quantity_, 1u);
+
+  // shrinking takes from the reserve before the displayed peak
+  orderbook.AddOrder(
+      Order::Iceberg(OrderType::GoodTillCancel, 7, Side::Sell, 105, 10, 4));
+  orderbook.ModifyOrder(OrderModify{7, 105, 5});
+  ASSERT_EQ(orderbook.GetDepth(1).GetAsks()[0].quantity_, 4u);
+  orderbook.ModifyOrder(OrderModify{7, 105, 2});
+  ASSERT_EQ(orderbook.GetDepth(1).GetAsks()[0].quantity_, 2u);
+
+  // a snapshot keeps the peak and the reserve
+  orderbook.AddOrder(
+      Order::Iceberg(OrderType::GoodTillCancel, 8, Side::Sell, 106, 9, 4));
+  Orderbook restored;
+  restored.Restore(orderbook.Snapshot());
+  ASSERT_EQ(restored.GetDepth(2).GetAsks()[1].quantity_, 4u);
+  trades = restored.AddOrder(
+      Order{OrderType::GoodTillCancel, 9, Side::Buy, 106, 11});
+  ASSERT_EQ(trades.size(), 4u);
+  ASSERT_EQ(trades[3].GetAskId(), 8u);
+  ASSERT_EQ(trades[3].GetQuantity(), 1u);
+
+  ASSERT_THROW(
+      Order::Iceberg(OrderType::FillAndKill, 10, Side::Buy, 100, 10, 2),
+      std::logic_error);
+
+  // a command carrying that peak is skipped rather than thrown
+  auto command =
+      Command::Add(Order{OrderType::FillAndKill, 10, Side::Buy, 106, 10});
+  command.peak_ = 2;
+  ASSERT_FALSE(command.IsWellFormed());
+  ASSERT_NO_THROW(restored.ProcessCommands(std::span{&command, 1}, trades));
+  ASSERT_FALSE(restored.Contains(10));
+}
+
+TEST(OrderbookAuctionTests, UncrossesAtTheMostVolumePrice) {
+  SpscRing<MarketDataEvent> ring{256};
+  LadderOrderbook orderbook{OrderbookOptions{.marketData_ = &ring}};
+  orderbook.StartAuction();
+  ASSERT_TRUE(orderbook.InAuction());
+
+  // the book is left crossed while orders accumulate
+  Trades trades;
+  for (const auto &order :
+       {Order{OrderType::GoodTillCancel, 1, Side::Buy, 102, 5},
+        Order{OrderType::GoodTillCancel, 2, Side::Buy, 101, 5},
+        Order{OrderType::GoodTillCancel, 3, Side::Buy, 100, 5},
+        Order{OrderType::GoodTillCancel, 4, Side::Sell, 99, 4},
+        Order{OrderType::GoodTillCancel, 5, Side::Sell, 100, 4},
+        Order{OrderType::GoodTillCancel, 6, Side::Sell, 101, 6},
+        Order{OrderType::FillAndKill, 7, Side::Sell, 99, 5}})
+    orderbook.AddOrder(order, trades);
+  ASSERT_TRUE(trades.empty());
+  ASSERT_FALSE(orderbook.Contains(7));
+  ASSERT_EQ(orderbook.GetDepth(1).GetBids()[0].price_, 102);
+  ASSERT_EQ(orderbook.GetDepth(1).GetAsks()[0].price_, 99);
+
+  // 10 can trade at 101, against at most 8 at any other price
+  const auto indication = orderbook.PublishIndicativeUncross();
+  ASSERT_EQ(indication.price_, 101);
+  ASSERT_EQ(indication.volume_, 10u);
+  ASSERT_EQ(indication.sellSurplus_, 4u);
+  ASSERT_EQ(indication.buySurplus_, 0u);
+
+  MarketDataEvent event;
+  ASSERT_TRUE(ring.TryPop(event)); // skips the order and level events
+  while (event.type_ != MarketDataEventType::AuctionIndication)
+    ASSERT_TRUE(ring.TryPop(event));
+  ASSERT_EQ(event.price_, 101);
+  ASSERT_EQ(event.quantity_, 10u);
+  ASSERT_EQ(event.side_, Side::Sell);
+
+  trades = orderbook.Uncross();
+  ASSERT_FALSE(orderbook.InAuction());
+  ASSERT_EQ(trades.size(), 4u);
+  Quantity volume{};
+  for (const auto &trade : trades) {
+    ASSERT_EQ(trade.GetPrice(), 101);
+    volume += trade.GetQuantity();
+  }
+  ASSERT_EQ(volume, 10u);
+  ASSERT_EQ(trades[0].GetBidId(), 1u);
+  ASSERT_EQ(trades[0].GetAskId(), 4u);
+
+  // what is left does not cross, and matching is continuous again
+  const auto depth = orderbook.GetDepth(1);
+  ASSERT_EQ(depth.GetBids()[0].price_, 100);
+  ASSERT_EQ(depth.GetAsks()[0].price_, 101);
+  ASSERT_EQ(depth.GetAsks()[0].quantity_, 4u);
+  trades = orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, 8, Side::Buy, 101, 1});
+  ASSERT_EQ(trades.size(), 1u);
+}
+
+TEST(OrderbookAuctionTests, IcebergReserveCountsTowardsTheUncross) {
+  Orderbook orderbook;
+  orderbook.StartAuction();
+  for (const auto &order :
+       {Order{OrderType::GoodTillCancel, 1, Side::Buy, 100, 21},
+        Order{OrderType::GoodTillCancel, 2, Side::Buy, 99, 3},
+        Order{OrderType::GoodTillCancel, 3, Side::Buy, 98, 16},
+        Order{OrderType::GoodTillCancel, 4, Side::Buy, 97, 20},
+        Order::Iceberg(OrderType::GoodTillCancel, 5, Side::Sell, 97, 50, 1),
+        Order{OrderType::GoodTillCancel, 6, Side::Sell, 100, 5}})
+    orderbook.AddOrder(order);
+
+  // showing 1, the iceberg still has 50 to trade: 50 at 97 beats the 26 that
+  // the displayed quantity alone would make of 100
+  const auto indication = orderbook.PublishIndicativeUncross();
+  ASSERT_EQ(indication.price_, 97);
+  ASSERT_EQ(indication.volume_, 50u);
+  ASSERT_EQ(indication.buySurplus_, 10u);
+
+  const auto trades = orderbook.Uncross();
+  Quantity volume{};
+  for (const auto &trade : trades) {
+    ASSERT_EQ(trade.GetPrice(), 97);
+    volume += trade.GetQuantity();
+  }
+  ASSERT_EQ(volume, indication.volume_);
+  ASSERT_FALSE(orderbook.Contains(5));
+
+  // nothing is left crossed for continuous matching to trip over
+  const auto depth = orderbook.GetDepth(1);
+  ASSERT_EQ(depth.GetBids()[0].price_, 97);
+  ASSERT_EQ(depth.GetBids()[0].quantity_, 10u);
+  ASSERT_EQ(depth.GetAsks()[0].price_, 100);
+  const auto fill = orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, 7, Side::Sell, 97, 4});
+  ASSERT_EQ(fill.size(), 1u);
+  ASSERT_EQ(fill[0].GetBidId(), 4u);
+}
+
+TEST(OrderbookTickTests, RefusesPricesOffTheTick) {
+  ASSERT_EQ(Cents::FromDecimal(101.25), 10'125);
+  ASSERT_EQ(Cents::ToDecimal(10'125), 101.25);
+  ASSERT_EQ(Pips::FromDecimal(1.0842), 10'842);
+
+  // quoted in cents, traded in nickels
+  Orderbook orderbook{OrderbookOptions{.tickSize_ = 5}};
+  orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, 1, Side::Sell, 10'125, 10});
+  orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, 2, Side::Sell, 10'127, 10});
+  ASSERT_TRUE(orderbook.Contains(1));
+  ASSERT_FALSE(orderbook.Contains(2));
+
+  orderbook.ModifyOrder(OrderModify{1, 10'133, 10});
+  ASSERT_EQ(orderbook.GetDepth(1).GetAsks()[0].price_, 10'125);
+
+  // market orders carry no price and are only checked against the book
+  const auto trades = orderbook.AddOrder(Order{3, Side::Buy, 4});
+  ASSERT_EQ(trades.size(), 1u);
+  ASSERT_EQ(trades[0].GetPrice(), 10'125);
+}
+
+TEST(OrderbookDepthTests, TopLevelsAndChangesSinceSequence) {
+  Orderbook orderbook;
+  Trades trades;
+  orderbook.AddOrders(
+      std::vector<Order>{{OrderType::GoodTillCancel, 1, Side::Buy, 100, 10},
+                         {OrderType::GoodTillCancel, 2, Side::Buy, 99, 10},
+                         {OrderType::GoodTillCancel, 3, Side::Buy, 98, 10},
+                         {OrderType::GoodTillCancel, 4, Side::Sell, 101, 10},
+                         {OrderType::GoodTillCancel, 5, Side::Sell, 101, 5}},
+      trades);
+
+  const auto depth = orderbook.GetDepth(2);
+  ASSERT_EQ(depth.GetBids().size(), 2u);
+  ASSERT_EQ(depth.GetBids()[0].price_, 100);
+  ASSERT_EQ(depth.GetBids()[1].price_, 99);
+  ASSERT_EQ(depth.GetAsks().size(), 1u);
+  ASSERT_EQ(depth.GetAsks()[0].quantity_, 15u);
+
+  const auto initial = orderbook.GetDepthUpdate(2, 0);
+  ASSERT_TRUE(initial.bids_.size() == 2 && initial.asks_.size() == 1);
+
+  // joining the best ask only touches that level
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 6, Side::Sell, 101, 4});
+  auto update = orderbook.GetDepthUpdate(2, initial.sequence_);
+  ASSERT_FALSE(update.bidsReplaced_ || update.asksReplaced_);
+  ASSERT_TRUE(update.bids_.empty());
+  ASSERT_EQ(update.asks_.size(), 1u);
+  ASSERT_EQ(update.asks_[0].quantity_, 19u);
+
+  // removing the best bid brings 98 into the top two, so bids come whole
+  orderbook.CancelOrder(1);
+  update = orderbook.GetDepthUpdate(2, update.sequence_);
+  ASSERT_TRUE(update.bidsReplaced_);
+  ASSERT_EQ(update.bids_.size(), 2u);
+  ASSERT_EQ(update.bids_[1].price_, 98);
+  ASSERT_TRUE(update.asks_.empty());
+
+  update = orderbook.GetDepthUpdate(2, update.sequence_);
+  ASSERT_TRUE(update.bids_.empty() && update.asks_.empty());
+}
+
+TEST(OrderbookMarketDataTests, PublishesLevelAndOrderEvents) {
+  using enum MarketDataEventType;
+  SpscRing<MarketDataEvent> ring{64};
+  Orderbook orderbook{OrderbookOptions{.marketData_ = &ring}};
+
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 1, Side::Sell, 101, 10});
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 2, Side::Sell, 101, 5});
+  orderbook.ModifyOrder(OrderModify{2, 101, 3});
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 3, Side::Buy, 101, 10});
+  orderbook.CancelOrder(2);
+
+  struct Expected {
+    MarketDataEventType type_;
+    OrderId orderId_;
+    Side side_;
+    Quantity quantity_;
+  };
+  const std::vector<Expected> expected{
+      {OrderAdd, 1, Side::Sell, 10},    {LevelAdd, 0, Side::Sell, 10},
+      {OrderAdd, 2, Side::Sell, 5},     {LevelChange, 0, Side::Sell, 15},
+      {OrderCancel, 2, Side::Sell, 2},  {LevelChange, 0, Side::Sell, 13},
+      {OrderAdd, 3, Side::Buy, 10},     {LevelAdd, 0, Side::Buy, 10},
+      {OrderExecute, 3, Side::Buy, 10}, {LevelDelete, 0, Side::Buy, 0},
+      {OrderExecute, 1, Side::Sell, 10}, {LevelChange, 0, Side::Sell, 3},
+      {OrderCancel, 2, Side::Sell, 3},  {LevelDelete, 0, Side::Sell, 0}};
+
+  MarketDataEvent event;
+  std::uint64_t sequence{};
+  for (const auto &want : expected) {
+    ASSERT_TRUE(ring.TryPop(event));
+    ASSERT_EQ(event.sequence_, ++sequence);
+    ASSERT_EQ(event.type_, want.type_);
+    ASSERT_EQ(event.orderId_, want.orderId_);
+    ASSERT_EQ(event.side_, want.side_);
+    ASSERT_EQ(event.price_, 101);
+    ASSERT_EQ(event.quantity_, want.quantity_);
+  }
+  ASSERT_FALSE(ring.TryPop(event));
+  ASSERT_EQ(orderbook.DroppedMarketData(), 0u);
+}
+
+TEST(CommandTextTests, ConvertedFixturesReplayLikeTheText) {
+  const auto command = ParseCommand("A FOK 7 S 101 25");
+  ASSERT_EQ(command.type_, CommandType::Add);
+  ASSERT_EQ(command.orderType_, OrderType::FillOrKill);
+  ASSERT_EQ(command.orderId_, 7u);
+  ASSERT_EQ(command.side_, Side::Sell);
+  ASSERT_EQ(command.price_, 101);
+  ASSERT_EQ(command.quantity_, 25u);
+  ASSERT_EQ(ParseCommand("M 7 99 5").type_, CommandType::Modify);
+  ASSERT_THROW(ParseCommand("A GTC 7 X 101 25"), std::logic_error);
+  ASSERT_THROW(ParseCommand("C 7 8"), std::logic_error);
+  ASSERT_THROW(ParseCommand("C x"), std::logic_error);
+
+  const auto path =
+      (std::filesystem::temp_directory_path() / "orderbook_fixture.journal")
+          .string();
+  for (const auto &entry : std::filesystem::directory_iterator{
+           OrderbookTestsFixture::TestFolderPath}) {
+    const auto [commands, result] =
+        InputHandler{}.GetCommands(entry.path());
+    ASSERT_EQ(ConvertTextToJournal(entry.path().string(), path),
+              commands.size());
+
+    SingleWriterOrderbook orderbook;
+    Trades trades;
+    JournalReader{path}.Replay(orderbook, trades);
+    const auto infos = orderbook.GetOrderInfos();
+    ASSERT_EQ(orderbook.Size(), result.allCount_) << entry.path();
+    ASSERT_EQ(infos.GetBids().size(), result.bidCount_) << entry.path();
+    ASSERT_EQ(infos.GetAsks().size(), result.askCount_) << entry.path();
+  }
+  std::filesystem::remove(path);
+}
+
+TEST(JournalTests, ReplayRebuildsBookAndTrades) {
+  const auto path =
+      (std::filesystem::temp_directory_path() / "orderbook_journal_test.bin")
+          .string();
+  std::filesystem::remove(path);
+
+  std::mt19937 gen{7};
+  std::uniform_int_distribution<Price> priceDist(95, 105);
+  std::uniform_int_distribution<Quantity> quantityDist(1, 50);
+  std::uniform_int_distribution<int> actionDist(0, 9);
+  const OrderType types[] = {OrderType::GoodTillCancel, OrderType::FillAndKill,
+                             OrderType::FillOrKill, OrderType::GoodForDay,
+                             OrderType::Market};
+
+  SingleWriterOrderbook live;
+  Trades liveTrades;
+  std::size_t prunes{};
+  {
+    JournalWriter journal{path, 7}; // odd batch so flushes split the stream
+    for (OrderId orderId = 1; orderId <= 2'000; ++orderId) {
+      const auto action = actionDist(gen);
+      Command command;
+      if (action < 6) {
+        const auto type = types[gen() % std::size(types)];
+        const auto side = orderId % 2 ? Side::Buy : Side::Sell;
+        command = Command::Add(
+            type == OrderType::Market
+                ? Order{orderId, side, quantityDist(gen)}
+                : Order{type, orderId, side, priceDist(gen),
+                        quantityDist(gen)});
+      } else if (action < 8)
+        command = Command::Cancel(gen() % orderId + 1);
+      else if (action < 9)
+        command = Command::Modify(OrderModify{gen() % orderId + 1,
+                                              priceDist(gen),
+                                              quantityDist(gen)});
+      else {
+        command = Command::PruneGoodForDay();
+        ++prunes;
+      }
+
+      journal.Append(command);
+      live.ProcessCommands(std::span{&command, 1}, liveTrades);
+    }
+  }
+
+  // a record torn by a crash mid-write is left out of the replay
+  {
+    std::ofstream torn{path, std::ios::binary | std::ios::app};
+    torn.write("\x01\x02\x03", 3);
+  }
+
+  JournalReader reader{path};
+  ASSERT_EQ(reader.Records().size(), 2'000u);
+
+  SingleWriterOrderbook replayed;
+  Trades replayedTrades;
+  ASSERT_EQ(reader.Replay(replayed, replayedTrades), 2'000u);
+
+  // another instrument's replay only takes the prunes, which cover every book
+  SingleWriterOrderbook other;
+  Trades otherTrades;
+  ASSERT_EQ(reader.Replay(other, otherTrades, 5), prunes);
+  ASSERT_EQ(other.Size(), 0u);
+
+  ASSERT_EQ(replayed.Size(), live.Size());
+  ASSERT_EQ(replayedTrades.size(), liveTrades.size());
+  for (std::size_t i = 0; i < liveTrades.size(); ++i) {
+    ASSERT_EQ(replayedTrades[i].GetBidId(), liveTrades[i].GetBidId());
+    ASSERT_EQ(replayedTrades[i].GetAskId(), liveTrades[i].GetAskId());
+    ASSERT_EQ(replayedTrades[i].GetPrice(), liveTrades[i].GetPrice());
+    ASSERT_EQ(replayedTrades[i].GetQuantity(), liveTrades[i].GetQuantity());
+  }
+
+  const auto liveDepth = live.GetDepth(100);
+  const auto replayedDepth = replayed.GetDepth(100);
+  ASSERT_EQ(replayedDepth.GetBids().size(), liveDepth.GetBids().size());
+  ASSERT_EQ(replayedDepth.GetAsks().size(), liveDepth.GetAsks().size());
+
+  std::filesystem::remove(path);
+}
+
+TEST(JournalTests, ReopeningCutsATornRecordBeforeAppending) {
+  const auto path =
+      (std::filesystem::temp_directory_path() / "orderbook_reopen_test.bin")
+          .string();
+  std::filesystem::remove(path);
+
+  {
+    JournalWriter journal{path};
+    journal.Append(Command::Add(
+        Order{OrderType::GoodTillCancel, 1, Side::Buy, 100, 10}));
+  }
+  {
+    std::ofstream torn{path, std::ios::binary | std::ios::app};
+    torn.write("\x01\x02\x03", 3);
+  }
+  {
+    JournalWriter journal{path};
+    journal.Append(Command::Add(
+        Order{OrderType::GoodTillCancel, 2, Side::Sell, 100, 4}));
+  }
+
+  ASSERT_EQ(std::filesystem::file_size(path),
+            sizeof(JournalHeader) + 2 * sizeof(JournalRecord));
+  JournalReader reader{path};
+  ASSERT_EQ(reader.Records()[1].orderId_, 2u);
+
+  SingleWriterOrderbook book;
+  Trades trades;
+  ASSERT_EQ(reader.Replay(book, trades), 2u);
+  ASSERT_EQ(trades.size(), 1u);
+  ASSERT_EQ(trades[0].GetQuantity(), 4u);
+
+  // a file that is not a journal is left alone
+  {
+    std::ofstream other{path, std::ios::binary | std::ios::trunc};
+    other.write("not a journal at all", 20);
+  }
+  ASSERT_THROW(JournalWriter{path}, std::logic_error);
+  ASSERT_EQ(std::filesystem::file_size(path), 20u);
+
+  std::filesystem::remove(path);
+}
+
+TEST(SnapshotTests, RestoreKeepsQueuesAndPartialFills) {
+  const auto path =
+      (std::filesystem::temp_directory_path() / "orderbook_snapshot_test.bin")
+          .string();
+
+  Orderbook original;
+  original.AddOrder(Order{OrderType::GoodTillCancel, 1, Side::Sell, 101, 10});
+  original.AddOrder(Order{OrderType::GoodForDay, 2, Side::Sell, 101, 5});
+  original.AddOrder(Order{OrderType::GoodTillCancel, 3, Side::Sell, 103, 7});
+  original.AddOrder(Order{OrderType::GoodTillCancel, 4, Side::Buy, 99, 8});
+  original.AddOrder(Order{OrderType::GoodTillCancel, 5, Side::Buy, 101, 4});
+  original.AddOrder(Order::StopLimit(7, Side::Sell, 99, 98, 3));
+
+  WriteSnapshot(path, original.Snapshot());
+  SnapshotReader reader{path};
+  ASSERT_EQ(reader.Orders().size(), 5u);
+
+  Orderbook restored;
+  restored.Restore(reader.Orders());
+  ASSERT_EQ(restored.Size(), original.Size());
+  ASSERT_THROW(restored.Restore(reader.Orders()), std::logic_error);
+
+  const auto depth = restored.GetDepth(10);
+  ASSERT_EQ(depth.GetAsks()[0].quantity_, 11u); // 6 left of order 1, plus 5
+  ASSERT_EQ(depth.GetBids()[0].quantity_, 8u);
+
+  // order 1 keeps its place ahead of order 2
+  const auto trades = restored.AddOrder(
+      Order{OrderType::GoodTillCancel, 6, Side::Buy, 101, 8});
+  ASSERT_EQ(trades.size(), 2u);
+  ASSERT_EQ(trades[0].GetAskId(), 1u);
+  ASSERT_EQ(trades[0].GetQuantity(), 6u);
+  ASSERT_EQ(trades[1].GetAskId(), 2u);
+
+  // the stop limit is back waiting for a trade at 99 or below
+  const auto fired =
+      restored.AddOrder(Order{OrderType::FillAndKill, 8, Side::Sell, 99, 1});
+  ASSERT_EQ(fired.size(), 2u);
+  ASSERT_EQ(fired[1].GetAskId(), 7u);
+  ASSERT_EQ(fired[1].GetPrice(), 98);
+
+  ASSERT_EQ(restored.NextExpiry(), original.NextExpiry());
+  restored.CancelGoodForDayOrders();
+  ASSERT_FALSE(restored.Contains(2));
+
+  std::filesystem::remove(path);
+}
+
+TEST(SnapshotTests, BadRecordsLeaveTheBookEmpty) {
+  Orderbook original;
+  original.AddOrder(Order{OrderType::GoodTillCancel, 1, Side::Sell, 101, 10});
+  original.AddOrder(Order{OrderType::GoodForDay, 2, Side::Buy, 99, 5});
+  const auto good = original.Snapshot();
+
+  // each corruption is in the last record (the ask), after a bid that would
+  // load fine
+  auto Corrupt = [&good](auto &&damage) {
+    auto snapshot = good;
+    damage(snapshot.back());
+    return snapshot;
+  };
+  using Bad = std::function<void(SnapshotOrder &)>;
+  for (const auto &damage :
+       {Bad{[](auto &saved) { saved.orderType_ = 42; }},
+        Bad{[](auto &saved) { saved.orderType_ = 1; }}, // FAK never rests
+        Bad{[](auto &saved) { saved.orderId_ = 2; }},
+        Bad{[](auto &saved) { saved.remainingQuantity_ = 50; }},
+        Bad{[](auto &saved) { saved.hiddenQuantity_ = 1; }},
+        Bad{[](auto &saved) { saved.peakQuantity_ = 2; saved.orderType_ = 2; }},
+        Bad{[](auto &saved) { saved.side_ = 7; }},
+        Bad{[](auto &saved) { saved.price_ = 99; }}}) { // crosses the bid
+    Orderbook restored;
+    ASSERT_THROW(restored.Restore(Corrupt(damage)), std::logic_error);
+    ASSERT_EQ(restored.Size(), 0u);
+    ASSERT_TRUE(restored.GetDepth(1).GetAsks().empty());
+    restored.Restore(good);
+    ASSERT_EQ(restored.Size(), 2u);
+  }
+
+  // off the tick, beyond the ladder, or expiring in a book without expiry
+  ASSERT_THROW(Orderbook{OrderbookOptions{.tickSize_ = 5}}.Restore(good),
+               std::logic_error);
+  auto farBid = good;
+  farBid.back().price_ = 1'000'000'000;
+  farBid.back().side_ = static_cast<std::uint8_t>(Side::Buy);
+  LadderOrderbook ladder{OrderbookOptions{.ladderMaxTicks_ = 256}};
+  ASSERT_THROW(ladder.Restore(farBid), std::logic_error);
+  ASSERT_EQ(ladder.Size(), 0u);
+  BasicOrderbook<OrderbookPolicies<TreeLevels, NoLock, NoExpiry>> noExpiry;
+  ASSERT_THROW(noExpiry.Restore(good), std::logic_error);
+  ASSERT_EQ(noExpiry.Size(), 0u);
+  ASSERT_TRUE(noExpiry.GetDepth(1).GetAsks().empty());
+
+  // a book in a call auction rests crossed, so it takes a crossed snapshot
+  auto crossed = good;
+  crossed.back().price_ = 99;
+  Orderbook auction;
+  auction.StartAuction();
+  auction.Restore(crossed);
+  ASSERT_EQ(auction.Uncross().size(), 1u);
+}
+
+TEST(ExpiryTests, SessionCloseFollowsOffset) {
+  using namespace std::chrono;
+
+  // 15:00 in New York (EDT) and 21:30 in London (BST), both 19:00 UTC
+  const Timestamp now = sys_days{2025y / June / 2} + 19h;
+  const TradingSession newYork{};
+  ASSERT_EQ(newYork.NextClose(now), sys_days{2025y / June / 2} + 20h);
+
+  const TradingSession london{.utcOffset_ = 60min, .close_ = 16h + 30min};
+  ASSERT_EQ(london.NextClose(now), sys_days{2025y / June / 3} + 15h + 30min);
+}
+
+TEST(ExpiryTests, ExpiresDueOrdersInBoundedBatches) {
+  using namespace std::chrono;
+
+  const Timestamp open = sys_days{2025y / June / 2} + 14h;
+  Orderbook orderbook{OrderbookOptions{.threading_ = Threading::SingleWriter}};
+  for (OrderId orderId = 1; orderId <= 3; ++orderId)
+    orderbook.AddOrder(Order{OrderType::GoodTillDate, orderId, Side::Buy, 99,
+                             10, open + 1min});
+  orderbook.AddOrder(
+      Order{OrderType::GoodTillDate, 4, Side::Buy, 98, 10, open + 1h});
+  orderbook.AddOrder(
+      Order{OrderType::GoodForDay, 5, Side::Sell, 101, 10, open + 2h});
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 6, Side::Sell, 102, 10});
+  orderbook.CancelOrder(2);
+  ASSERT_EQ(orderbook.NextExpiry(), open + 1min);
+
+  ASSERT_EQ(orderbook.CancelExpiredOrders(open, 10), 0u);
+  ASSERT_EQ(orderbook.CancelExpiredOrders(open + 1min, 2), 2u);
+  ASSERT_EQ(orderbook.CancelExpiredOrders(open + 1min, 2), 1u);
+  ASSERT_EQ(orderbook.Size(), 3u);
+  ASSERT_EQ(orderbook.NextExpiry(), open + 1h);
+
+  // an Expire command is how the core and a replay drive the same sweep
+  const auto expire = Command::Expire(open + 3h, 10);
+  Trades trades;
+  orderbook.ProcessCommands(std::span{&expire, 1}, trades);
+  ASSERT_EQ(orderbook.Size(), 1u);
+  ASSERT_TRUE(orderbook.Contains(6));
+  ASSERT_EQ(orderbook.NextExpiry(), Timestamp::max());
+}
+
+TEST(ExpiryTests, CancelledIdsDoNotPileUp) {
+  using namespace std::chrono;
+
+  const Timestamp close = sys_days{2025y / June / 2} + 21h;
+  ExpiryIndex index{std::pmr::new_delete_resource()};
+  std::unordered_set<OrderId> live;
+  auto IsLive = [&live](OrderId orderId, Timestamp) {
+    return live.contains(orderId);
+  };
+
+  // the book's pattern: compact before an add once mostly stale, every order
+  // sent is cancelled straight away but one in ten
+  for (OrderId orderId = 1; orderId <= 10'000; ++orderId) {
+    if (index.IsMostlyStale())
+      index.Compact(IsLive);
+    index.Add(close, orderId);
+    live.insert(orderId);
+    if (orderId % 10 != 0) {
+      live.erase(orderId);
+      index.Retire();
+    }
+  }
+  ASSERT_LE(index.size(), 2 * live.size() + 64);
+  index.Compact(IsLive);
+  ASSERT_EQ(index.size(), live.size());
+
+  // the same flow through a book still expires exactly what rests
+  SingleWriterOrderbook orderbook;
+  for (OrderId orderId = 1; orderId <= 10'000; ++orderId) {
+    orderbook.AddOrder(Order{OrderType::GoodForDay, orderId, Side::Buy,
+                             static_cast<Price>(90 + orderId % 10), 1, close});
+    if (orderId % 10 != 0)
+      orderbook.CancelOrder(orderId);
+  }
+  orderbook.AddOrder(
+      Order{OrderType::GoodTillCancel, 10'001, Side::Buy, 90, 1});
+  ASSERT_EQ(orderbook.Size(), 1'001u);
+  // what the sweep pops is the index, stale ids and all
+  ASSERT_LE(orderbook.CancelExpiredOrders(close, 10'000), 2 * 1'000u + 64);
+  ASSERT_EQ(orderbook.Size(), 1u);
+  ASSERT_EQ(orderbook.NextExpiry(), Timestamp::max());
+}
+
+TEST(ExpiryTests, ExpiryThreadCancelsGoodTillDate) {
+  Orderbook orderbook;
+  const auto expiry = std::chrono::time_point_cast<Timestamp::duration>(
+                          std::chrono::system_clock::now()) +
+                      std::chrono::milliseconds(50);
+  orderbook.AddOrder(
+      Order{OrderType::GoodTillDate, 1, Side::Buy, 100, 10, expiry});
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 2, Side::Buy, 99, 10});
+
+  for (int i = 0; i < 200 && orderbook.Contains(1); ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_FALSE(orderbook.Contains(1));
+  ASSERT_TRUE(orderbook.Contains(2));
+}
+
+TEST(OrderbookPolicyTests, CompileTimePoliciesMatchTheDefaults) {
+  using namespace std::chrono;
+
+  const Timestamp open = sys_days{2025y / June / 2} + 14h;
+  const std::vector<Order> orders{
+      Order{OrderType::GoodTillCancel, 1, Side::Buy, 100, 10},
+      Order{OrderType::GoodTillCancel, 3, Side::Sell, 101, 5},
+      Order{OrderType::FillAndKill, 4, Side::Sell, 100, 4},
+      Order::Iceberg(OrderType::GoodTillCancel, 5, Side::Sell, 102, 9, 3)};
+
+  Orderbook locked;
+  SingleWriterOrderbook singleWriter;
+  for (const auto &order : orders)
+    ASSERT_EQ(locked.AddOrder(order).size(),
+              singleWriter.AddOrder(order).size());
+  ASSERT_EQ(locked.Size(), singleWriter.Size());
+  const auto lockedAsks = locked.GetOrderInfos().GetAsks();
+  const auto singleWriterAsks = singleWriter.GetOrderInfos().GetAsks();
+  ASSERT_EQ(lockedAsks.size(), singleWriterAsks.size());
+  for (std::size_t i = 0; i < lockedAsks.size(); ++i)
+    ASSERT_EQ(lockedAsks[i].quantity_, singleWriterAsks[i].quantity_);
+
+  // without a thread the owner drives expiry
+  const Order goodTillDate{OrderType::GoodTillDate, 2, Side::Buy, 99, 10,
+                           open + 1min};
+  singleWriter.AddOrder(goodTillDate);
+  ASSERT_EQ(singleWriter.NextExpiry(), open + 1min);
+  ASSERT_EQ(singleWriter.CancelExpiredOrders(open + 1min, 10), 1u);
+  ASSERT_FALSE(singleWriter.Contains(2));
+
+  // a book with no expiry index refuses anything that would need one
+  BasicOrderbook<OrderbookPolicies<LadderLevels, NoLock, NoExpiry>> noExpiry;
+  noExpiry.AddOrder(goodTillDate);
+  noExpiry.AddOrder(Order{OrderType::GoodForDay, 6, Side::Buy, 98, 10, open});
+  noExpiry.AddOrder(orders[0]);
+  ASSERT_EQ(noExpiry.Size(), 1u);
+  ASSERT_EQ(noExpiry.NextExpiry(), Timestamp::max());
+  ASSERT_EQ(noExpiry.CancelExpiredOrders(Timestamp::max(), 10), 0u);
+}
+
+TEST(LatencyHistogramTests, PercentilesWithinBucketPrecision) {
+  LatencyHistogram histogram;
+  for (std::uint64_t value = 1; value <= 100'000; ++value)
+    histogram.Record(value);
+
+  ASSERT_EQ(histogram.Count(), 100'000u);
+  ASSERT_EQ(histogram.Min(), 1u);
+  ASSERT_EQ(histogram.Max(), 100'000u);
+  ASSERT_DOUBLE_EQ(histogram.Mean(), 50'000.5);
+
+  // exact below 128, within 1/64 above
+  for (const double percentile : {0.1, 50.0, 90.0, 99.0, 99.9, 99.99}) {
+    const auto expected = static_cast<double>(percentile * 1'000);
+    const auto reported = static_cast<double>(histogram.Percentile(percentile));
+    ASSERT_GE(reported, expected);
+    ASSERT_LE(reported, expected * (1 + 1.0 / 64));
+  }
+  ASSERT_EQ(histogram.Percentile(100), 100'000u);
+
+  LatencyHistogram other;
+  other.Record(1'000'000'000);
+  histogram.Merge(other);
+  ASSERT_EQ(histogram.Max(), 1'000'000'000u);
+  ASSERT_EQ(histogram.Percentile(100), 1'000'000'000u);
+}
+
+TEST(TraceTests, SpansFeedHistogramsAndChromeTrace) {
+  Trace::Reset();
+  for (int i = 0; i < 10; ++i) {
+    TraceSpan span{TraceStage::MatchLoop};
+  }
+  std::thread{[]() { TraceSpan span{TraceStage::Validate}; }}.join();
+
+  const auto histograms = Trace::StageHistograms();
+  ASSERT_EQ(histograms[static_cast<std::size_t>(TraceStage::Validate)].Count(),
+            1u);
+  ASSERT_GE(histograms[static_cast<std::size_t>(TraceStage::MatchLoop)].Count(),
+            10u);
+
+  const auto path =
+      (std::filesystem::temp_directory_path() / "orderbook_trace_test.json")
+          .string();
+  Trace::WriteChromeTrace(path);
+  std::ifstream file{path};
+  const std::string json{std::istreambuf_iterator<char>{file}, {}};
+  ASSERT_TRUE(json.starts_with("{\"traceEvents\":["));
+  ASSERT_NE(json.find("\"name\":\"validate\",\"ph\":\"X\""),
+            std::string::npos);
+
+  std::filesystem::remove(path);
+  Trace::Reset();
+}
+
+TEST(SpscRingTests, WrapsAroundInOrder) {
+  SpscRing<int> ring{4};
+  int value{};
+
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i)
+      ASSERT_TRUE(ring.TryPush(round * 4 + i));
+    ASSERT_FALSE(ring.TryPush(-1));
+
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(ring.TryPop(value));
+      ASSERT_EQ(value, round * 4 + i);
+    }
+    ASSERT_FALSE(ring.TryPop(value));
+  }
+}
+
+TEST(MatchingCoreTests, ReportsAcksRejectsAndTrades) {
+  MatchingCoreOptions options;
+  options.gateways_ = 2;
+  options.ringCapacity_ = 8;
+  MatchingCore core{options};
+
+  auto Next = [&core](std::size_t gateway) {
+    Report report;
+    while (!core.Poll(gateway, report))
+      std::this_thread::yield();
+    return report;
+  };
+
+  // the core round robins the gateways, so only an ack orders the buy before
+  // the other gateway's sell
+  ASSERT_TRUE(core.Submit(0, Command::Add(Order{OrderType::GoodTillCancel, 1,
+                                                Side::Buy, 100, 10})));
+  const auto ack = Next(0);
+  ASSERT_EQ(ack.type_, ReportType::Accepted);
+  ASSERT_EQ(ack.orderId_, 1u);
+
+  ASSERT_TRUE(core.Submit(1, Command::Add(Order{OrderType::GoodTillCancel, 2,
+                                                Side::Sell, 100, 4})));
+  ASSERT_TRUE(core.Submit(1, Command::Cancel(3)));
+  ASSERT_EQ(Next(1).type_, ReportType::Accepted);
+  const auto trade = Next(1);
+  ASSERT_EQ(trade.type_, ReportType::Trade);
+  ASSERT_EQ(trade.bidId_, 1u);
+  ASSERT_EQ(trade.askId_, 2u);
+  ASSERT_EQ(trade.quantity_, 4u);
+
+  const auto reject = Next(1);
+  ASSERT_EQ(reject.type_, ReportType::Rejected);
+  ASSERT_EQ(reject.command_, CommandType::Cancel);
+
+  // the resting buy's gateway hears about its fill too
+  const auto fill = Next(0);
+  ASSERT_EQ(fill.type_, ReportType::Trade);
+  ASSERT_EQ(fill.orderId_, 2u);
+  ASSERT_EQ(fill.bidId_, 1u);
+  ASSERT_EQ(fill.quantity_, 4u);
+
+  // pruning runs through the same ring as everything else
+  ASSERT_TRUE(core.Submit(
+      0, Command::Add(Order{OrderType::GoodForDay, 5, Side::Buy, 90, 10})));
+  ASSERT_TRUE(core.Submit(0, Command::PruneGoodForDay()));
+  ASSERT_TRUE(core.Submit(0, Command::Cancel(5)));
+  ASSERT_EQ(Next(0).type_, ReportType::Accepted);
+  ASSERT_EQ(Next(0).command_, CommandType::PruneGoodForDay);
+  ASSERT_EQ(Next(0).type_, ReportType::Rejected);
+
+  // a malformed add is rejected, not thrown on the core thread
+  auto iceberg =
+      Command::Add(Order{OrderType::FillAndKill, 6, Side::Sell, 100, 5});
+  iceberg.peak_ = 5;
+  ASSERT_TRUE(core.Submit(0, iceberg));
+  const auto malformed = Next(0);
+  ASSERT_EQ(malformed.type_, ReportType::Rejected);
+  ASSERT_EQ(malformed.orderId_, 6u);
+}
+
+TEST(MatchingCoreTests, TickSizePerInstrument) {
+  MatchingCoreOptions options;
+  options.instruments_ = {1, 2};
+  options.tickSizes_ = {{2, 25}};
+  MatchingCore core{options};
+
+  auto Submit = [&core](InstrumentId instrumentId, OrderId orderId) {
+    EXPECT_TRUE(core.Submit(
+        0, Command::Add(Order{OrderType::GoodTillCancel, orderId, Side::Buy,
+                              110, 1},
+                        instrumentId)));
+    Report report;
+    while (!core.Poll(0, report))
+      std::this_thread::yield();
+    return report.type_;
+  };
+
+  ASSERT_EQ(Submit(1, 1), ReportType::Accepted);
+  ASSERT_EQ(Submit(2, 2), ReportType::Rejected);
+}
+
+TEST(MatchingEngineTests, RoutesByInstrumentAndPrunesEveryWorker) {
+  const std::vector<InstrumentId> instruments{1, 2, 3};
+  MatchingEngineOptions options;
+  options.workers_ = 2;
+  options.ringCapacity_ = 8;
+  MatchingEngine engine{instruments, options};
+  ASSERT_EQ(engine.WorkerOf(1), engine.WorkerOf(3));
+  ASSERT_NE(engine.WorkerOf(1), engine.WorkerOf(2));
+
+  auto Next = [&engine]() {
+    Report report;
+    while (!engine.Poll(0, report))
+      std::this_thread::yield();
+    return report;
+  };
+
+  // order ids only have to be unique within a book
+  for (const InstrumentId instrumentId : {1, 2}) {
+    ASSERT_TRUE(engine.Submit(
+        0, Command::Add(Order{OrderType::GoodForDay, 1, Side::Buy, 100, 10},
+                        instrumentId)));
+    ASSERT_EQ(Next().instrumentId_, instrumentId);
+  }
+  ASSERT_TRUE(engine.Submit(
+      0, Command::Add(Order{OrderType::GoodTillCancel, 2, Side::Sell, 100, 4},
+                      2)));
+  ASSERT_EQ(Next().type_, ReportType::Accepted);
+  const auto trade = Next();
+  ASSERT_EQ(trade.type_, ReportType::Trade);
+  ASSERT_EQ(trade.instrumentId_, 2u);
+
+  ASSERT_TRUE(engine.Submit(0, Command::Cancel(1, 7)));
+  ASSERT_EQ(Next().type_, ReportType::Rejected);
+
+  engine.PruneGoodForDay();
+  for (const InstrumentId instrumentId : {1, 2}) {
+    ASSERT_TRUE(engine.Submit(0, Command::Cancel(1, instrumentId)));
+    ASSERT_EQ(Next().type_, ReportType::Rejected);
+  }
+}
@@ -0,0 +1,35 @@
+#include "pch.h"
+
+// built from OrderBook.h alone, like any user of the library: none of these
+// policy combinations is compiled into the library, so they only link if
+// the header carries the definitions
+
+#include "OrderBook.h"
+
+template <typename OrderbookType> void MatchesAndCancels() {
+  OrderbookType orderbook;
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 1, Side::Buy, 100, 10});
+  orderbook.AddOrder(Order{OrderType::GoodTillCancel, 2, Side::Buy, 99, 5});
+
+  const auto trades =
+      orderbook.AddOrder(Order{OrderType::FillAndKill, 3, Side::Sell, 100, 4});
+  ASSERT_EQ(trades.size(), 1u);
+  ASSERT_EQ(trades[0].GetBidId(), 1u);
+  ASSERT_EQ(trades[0].GetQuantity(), 4u);
+
+  orderbook.CancelOrder(2);
+  ASSERT_EQ(orderbook.Size(), 1u);
+  ASSERT_EQ(orderbook.GetDepth(1).GetBids()[0].quantity_, 6u);
+}
+
+TEST(PolicyTests, MutexLockNoExpiryLinksFromTheHeader) {
+  MatchesAndCancels<
+      BasicOrderbook<OrderbookPolicies<TreeLevels, MutexLock, NoExpiry>>>();
+  MatchesAndCancels<
+      BasicOrderbook<OrderbookPolicies<LadderLevels, MutexLock, NoExpiry>>>();
+}
+
+TEST(PolicyTests, MutexLockExpiryThreadLinksFromTheHeader) {
+  MatchesAndCancels<
+      BasicOrderbook<OrderbookPolicies<TreeLevels, MutexLock, ExpiryThread>>>();
+}